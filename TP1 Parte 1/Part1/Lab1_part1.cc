@@ -1,37 +1,293 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/internet-module.h"
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/ipv4-static-routing-helper.h"
+#include "ns3/nix-vector-routing-module.h"
+#include "echo-rtt.h"
+#include "result-cache.h"
+#include "scheduler.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE("Lab1Part1Script");
 
+// Revision of this program's output, the first line of its --cacheDir result
+// key; result-cache.h adds the build of the program and of ns-3.
+static const char *kResultCacheVersion = "lab1-part1 r1";
+
+// --loadRate: open-loop UDP load on raw sockets instead of the echo clients.
+// Every client sends Poisson traffic at the rate of the current ramp step;
+// each packet carries a SeqTsHeader, so the echo brings its own send time
+// back and no per-packet state is kept. Steps are separated by a short drain
+// so late echoes still count towards the step that sent them.
+static const double kLoadDrain = 0.5;
+
+struct LoadStep
+{
+    double rate = 0.0;
+    uint64_t sent = 0;
+    uint64_t sentBytes = 0;
+    uint64_t echoed = 0;
+    uint64_t echoedBytes = 0;
+    LogHistogram rttUs;
+};
+
+struct LoadGenerator
+{
+    std::vector<Ptr<Socket>> sockets;
+    std::vector<LoadStep> steps;
+    Time start;
+    Time stepDuration;
+    Time stepPeriod;
+    uint32_t seq = 0;
+    uint32_t minSize = 0;
+    uint32_t maxSize = 0;
+    bool imix = false;
+    Ptr<ExponentialRandomVariable> gap;
+    Ptr<UniformRandomVariable> size;
+};
+
+static LoadGenerator load;
+
+// "<bytes>", "<min>-<max>" (uniform) or "imix" (64/576/1500 in 7:4:1)
+static void
+ParseLoadSize(std::string spec)
+{
+    std::size_t dash = spec.find('-');
+    if (spec == "imix") {
+        load.imix = true;
+    } else if (dash != std::string::npos) {
+        load.minSize = std::stoul(spec.substr(0, dash));
+        load.maxSize = std::stoul(spec.substr(dash + 1));
+    } else {
+        load.minSize = load.maxSize = std::stoul(spec);
+    }
+    NS_ABORT_MSG_UNLESS(load.imix || (load.minSize >= 12 && load.minSize <= load.maxSize),
+                        "loadSize must be imix, <bytes> or <min>-<max> with at least 12 bytes");
+}
+
+static uint32_t
+SampleLoadSize()
+{
+    if (load.imix) {
+        double u = load.size->GetValue(0.0, 12.0);
+        return u < 7.0 ? 64 : u < 11.0 ? 576 : 1500;
+    }
+    return load.size->GetInteger(load.minSize, load.maxSize);
+}
+
+static uint32_t
+LoadStepOf(Time sent)
+{
+    return (sent - load.start).GetTimeStep() / load.stepPeriod.GetTimeStep();
+}
+
+static void
+LoadSend(uint32_t client)
+{
+    uint32_t step = LoadStepOf(Simulator::Now());
+    if (step >= load.steps.size()) {
+        return;
+    }
+    Time intoStep = TimeStep((Simulator::Now() - load.start).GetTimeStep() % load.stepPeriod.GetTimeStep());
+    if (intoStep >= load.stepDuration) {
+        Simulator::Schedule(load.stepPeriod - intoStep, &LoadSend, client);
+        return;
+    }
+
+    SeqTsHeader header;
+    header.SetSeq(load.seq++);
+    uint32_t bytes = std::max(SampleLoadSize(), header.GetSerializedSize());
+    Ptr<Packet> packet = Create<Packet>(bytes - header.GetSerializedSize());
+    packet->AddHeader(header);
+    if (load.sockets[client]->Send(packet) >= 0) {
+        ++load.steps[step].sent;
+        load.steps[step].sentBytes += bytes;
+    }
+    Simulator::Schedule(Seconds(load.gap->GetValue(1.0 / load.steps[step].rate, 0.0)), &LoadSend, client);
+}
+
+static void
+LoadReceive(Ptr<Socket> socket)
+{
+    Ptr<Packet> packet;
+    while ((packet = socket->Recv())) {
+        uint32_t bytes = packet->GetSize();
+        SeqTsHeader header;
+        packet->RemoveHeader(header);
+        uint32_t step = LoadStepOf(header.GetTs());
+        if (step < load.steps.size()) {
+            LoadStep &s = load.steps[step];
+            ++s.echoed;
+            s.echoedBytes += bytes;
+            s.rttUs.Add((Simulator::Now() - header.GetTs()).GetNanoSeconds() / 1000.0);
+        }
+    }
+}
+
+// Returns the time at which the last step's drain ends.
+static double
+StartLoad(NodeContainer clients, Ipv4Address server, uint16_t port, double start, double rate,
+          double rampStep, uint32_t rampSteps, double stepDuration)
+{
+    load.start = Seconds(start);
+    load.stepDuration = Seconds(stepDuration);
+    load.stepPeriod = Seconds(stepDuration + kLoadDrain);
+    load.gap = CreateObject<ExponentialRandomVariable>();
+    load.size = CreateObject<UniformRandomVariable>();
+    load.steps.resize(rampSteps);
+    for (uint32_t k = 0; k < rampSteps; ++k) {
+        load.steps[k].rate = rate + k * rampStep;
+    }
+    Ptr<UniformRandomVariable> offset = CreateObject<UniformRandomVariable>();
+    for (uint32_t i = 0; i < clients.GetN(); ++i)
+    {
+        Ptr<Socket> socket = Socket::CreateSocket(clients.Get(i), UdpSocketFactory::GetTypeId());
+        socket->Bind();
+        socket->Connect(InetSocketAddress(server, port));
+        socket->SetRecvCallback(MakeCallback(&LoadReceive));
+        load.sockets.push_back(socket);
+        // Spread the first sends so the clients do not start in lockstep
+        Simulator::Schedule(Seconds(start + offset->GetValue(0.0, 1.0 / rate)), &LoadSend, i);
+    }
+    return start + rampSteps * (stepDuration + kLoadDrain);
+}
+
+// One line per ramp step, then the knee: the last step before echo loss
+// passes 1% or p99 RTT doubles relative to the first step with echoes.
+static void
+PrintLoadReport(std::string tag, uint32_t nClients)
+{
+    double stepSeconds = load.stepDuration.GetSeconds();
+    double baseP99 = 0.0;
+    int knee = -1;
+    bool saturated = false;
+    for (uint32_t k = 0; k < load.steps.size(); ++k)
+    {
+        const LoadStep &s = load.steps[k];
+        double offeredMbps = s.sentBytes * 8.0 / stepSeconds / 1e6;
+        double echoMbps = s.echoedBytes * 8.0 / stepSeconds / 1e6;
+        double loss = s.sent > 0 ? 1.0 - static_cast<double>(s.echoed) / s.sent : 0.0;
+        double p50 = s.rttUs.Percentile(50) / 1000;
+        double p90 = s.rttUs.Percentile(90) / 1000;
+        double p99 = s.rttUs.Percentile(99) / 1000;
+        std::cout << "Load step " << k << ": " << s.rate << " pkt/s per client (" << nClients << " clients), offered "
+                  << offeredMbps << " Mbps, echoed " << echoMbps << " Mbps, loss " << loss * 100 << "%, RTT p50 "
+                  << p50 << " ms, p90 " << p90 << " ms, p99 " << p99 << " ms, max " << s.rttUs.max / 1000 << " ms"
+                  << std::endl;
+        std::cout << "PARSE_LOAD," << tag << "," << k << "," << s.rate << "," << offeredMbps << "," << echoMbps
+                  << "," << loss << "," << p50 << "," << p90 << "," << p99 << "," << s.rttUs.max / 1000 << std::endl;
+        if (baseP99 == 0.0 && s.rttUs.total > 0) {
+            baseP99 = p99;
+        }
+        if (!saturated && (loss > 0.01 || (baseP99 > 0.0 && p99 > 2 * baseP99))) {
+            saturated = true;
+        }
+        if (!saturated) {
+            knee = k;
+        }
+    }
+    if (!saturated) {
+        std::cout << "Knee: not reached (raise loadRate or rampSteps)" << std::endl;
+    } else if (knee < 0) {
+        std::cout << "Knee: below the first step" << std::endl;
+    } else {
+        const LoadStep &s = load.steps[knee];
+        std::cout << "Knee: step " << knee << ", " << s.rate << " pkt/s per client, "
+                  << s.sentBytes * 8.0 / stepSeconds / 1e6 << " Mbps offered" << std::endl;
+    }
+    std::cout << "PARSE_KNEE," << tag << "," << saturated << "," << knee << ","
+              << (knee >= 0 ? load.steps[knee].rate : 0.0) << ","
+              << (knee >= 0 ? load.steps[knee].sentBytes * 8.0 / stepSeconds / 1e6 : 0.0) << std::endl;
+}
+
 int
 main(int argc, char* argv[])
 {
     uint32_t nClients = 5;
     uint32_t nPackets = 4;
+    std::string scheduler = "map";
+    std::string cacheDir = "";
+    bool largeStar = false;
+    bool verbose = false;
+    std::string rttCsv = "";
+    double loadRate = 0.0;
+    std::string loadSize = "1024";
+    double stepDuration = 5.0;
+    uint32_t rampSteps = 1;
+    double rampStep = 0.0;
+    std::string routing = "global";
 
     CommandLine cmd(__FILE__);
     cmd.AddValue("nClients", "Number of client nodes", nClients);
     cmd.AddValue("nPackets", "Number of packets per client", nPackets);
+    cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or priorityqueue", scheduler);
+    cmd.AddValue("largeStar", "Lift the 5 client limit, with one /30 per link from 10.0.0.0/8", largeStar);
+    cmd.AddValue("routing", "global (all-pairs Ipv4GlobalRouting), static (client default routes) or nix (on-demand Nix-vector)", routing);
+    cmd.AddValue("verbose", "Enable the echo applications' INFO logs (slow; RTTs are collected without them)", verbose);
+    cmd.AddValue("rttCsv", "Also write every echo RTT to this CSV (client,tx_s,rtt_ms); empty disables", rttCsv);
+    cmd.AddValue("loadRate", "Open-loop load: Poisson packets/s per client (first ramp step); 0 keeps the echo clients", loadRate);
+    cmd.AddValue("loadSize", "Load packet size: <bytes>, <min>-<max> (uniform) or imix", loadSize);
+    cmd.AddValue("stepDuration", "Seconds of load per ramp step", stepDuration);
+    cmd.AddValue("rampSteps", "Number of load steps", rampSteps);
+    cmd.AddValue("rampStep", "Packets/s per client added at each step; 0 uses loadRate", rampStep);
+    cmd.AddValue("cacheDir", "Reuse results of identical runs stored in this directory (safe to share between parallel runs); empty disables. Runs writing an RTT CSV bypass it; timings are never cached", cacheDir);
     cmd.Parse(argc, argv);
 
-    if (nClients > 5) {
-        std::cout << "Error: Maximum number of clients is 5." << std::endl;
+    if (nClients > 5 && !largeStar) {
+        std::cout << "Error: Maximum number of clients is 5 (use --largeStar for more)." << std::endl;
         return 1;
     }
     if (nPackets > 5) {
         std::cout << "Error: Maximum number of packets per client is 5." << std::endl;
         return 1;
     }
+    if (nClients == 0 || nClients > (1u << 22)) {
+        std::cout << "Error: nClients must be between 1 and 4194304 (/30 links in 10.0.0.0/8)." << std::endl;
+        return 1;
+    }
+    NS_ABORT_MSG_UNLESS(routing == "global" || routing == "static" || routing == "nix",
+                        "Unknown routing " << routing);
+    NS_ABORT_MSG_IF(loadRate < 0 || (loadRate > 0 && (rampSteps == 0 || stepDuration <= 0)),
+                    "loadRate needs rampSteps >= 1 and a positive stepDuration");
+    if (loadRate > 0) {
+        ParseLoadSize(loadSize);
+    }
+    // The RTT CSV is not stored, so runs writing it always simulate
+    bool cacheable = !cacheDir.empty() && rttCsv.empty();
+    if (cacheable && LookupCachedResult(cacheDir, ResultCacheKey(kResultCacheVersion, argc, argv)))
+    {
+        return 0;
+    }
 
+    auto setupStart = std::chrono::steady_clock::now();
     Time::SetResolution(Time::NS);
-    LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
-    LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    SetScheduler(scheduler);
+    if (verbose) {
+        LogComponentEnable("UdpEchoClientApplication", LOG_LEVEL_INFO);
+        LogComponentEnable("UdpEchoServerApplication", LOG_LEVEL_INFO);
+    }
 
     NodeContainer serverNode;
     serverNode.Create(1);
@@ -42,26 +298,54 @@ main(int argc, char* argv[])
     pointToPoint.SetDeviceAttribute("DataRate", StringValue("5Mbps"));
     pointToPoint.SetChannelAttribute("Delay", StringValue("2ms"));
 
+    // Global routing runs an all-pairs route computation over the whole star;
+    // the server is directly connected to every link, so clients only need a
+    // default route (static) or a path found on first use (nix).
     InternetStackHelper stack;
+    Ipv4StaticRoutingHelper staticRouting;
+    Ipv4NixVectorHelper nixRouting;
+    if (routing == "static") {
+        stack.SetRoutingHelper(staticRouting);
+    } else if (routing == "nix") {
+        stack.SetRoutingHelper(nixRouting);
+    }
     stack.Install(serverNode);
     stack.Install(clientNodes);
 
     Ipv4AddressHelper address;
     std::vector<Ipv4InterfaceContainer> clientInterfaces;
+    clientInterfaces.reserve(nClients);
+    if (largeStar) {
+        // 10.1.<i+1>.0/24 runs out after 254 links; /30s cover 2^22 of them
+        address.SetBase("10.0.0.0", "255.255.255.252");
+    }
 
     for (uint32_t i = 0; i < nClients; ++i)
     {
         NodeContainer linkNodes(clientNodes.Get(i), serverNode.Get(0)); 
         NetDeviceContainer linkDevices = pointToPoint.Install(linkNodes);
 
-        std::string baseIp = "10.1." + std::to_string(i + 1) + ".0";
-        address.SetBase(Ipv4Address(baseIp.c_str()), "255.255.255.0");
+        if (!largeStar) {
+            std::string baseIp = "10.1." + std::to_string(i + 1) + ".0";
+            address.SetBase(Ipv4Address(baseIp.c_str()), "255.255.255.0");
+        }
         Ipv4InterfaceContainer interfaces = address.Assign(linkDevices);
+        if (largeStar) {
+            address.NewNetwork();
+        }
+
+        if (routing == "static") {
+            // Interface 0 is the loopback, 1 the link to the server
+            Ptr<Ipv4> clientIpv4 = clientNodes.Get(i)->GetObject<Ipv4>();
+            staticRouting.GetStaticRouting(clientIpv4)->SetDefaultRoute(interfaces.GetAddress(1), 1);
+        }
 
         clientInterfaces.push_back(interfaces);
     }
 
-    Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    if (routing == "global") {
+        Ipv4GlobalRoutingHelper::PopulateRoutingTables();
+    }
 
     UdpEchoServerHelper echoServer(15);
     ApplicationContainer serverApps = echoServer.Install(serverNode.Get(0));
@@ -69,26 +353,52 @@ main(int argc, char* argv[])
     serverApps.Stop(Seconds(20.0));
 
     Ipv4Address serverIp = clientInterfaces[0].GetAddress(1); 
+    ApplicationContainer allClients;
+    double stopTime = 20.0;
 
-    for (uint32_t i = 0; i < nClients; ++i)
-    {
-        UdpEchoClientHelper echoClient(serverIp, 15);
-        echoClient.SetAttribute("MaxPackets", UintegerValue(nPackets));
-        echoClient.SetAttribute("Interval", TimeValue(Seconds(1.0)));
-        echoClient.SetAttribute("PacketSize", UintegerValue(1024));
+    if (loadRate > 0) {
+        stopTime = StartLoad(clientNodes, serverIp, 15, 2.0, loadRate, rampStep > 0 ? rampStep : loadRate, rampSteps,
+                             stepDuration);
+        serverApps.Stop(Seconds(stopTime));
+    } else {
+        for (uint32_t i = 0; i < nClients; ++i)
+        {
+            UdpEchoClientHelper echoClient(serverIp, 15);
+            echoClient.SetAttribute("MaxPackets", UintegerValue(nPackets));
+            echoClient.SetAttribute("Interval", TimeValue(Seconds(1.0)));
+            echoClient.SetAttribute("PacketSize", UintegerValue(1024));
 
-        ApplicationContainer clientApps = echoClient.Install(clientNodes.Get(i));
+            ApplicationContainer clientApps = echoClient.Install(clientNodes.Get(i));
+            allClients.Add(clientApps);
 
-        Ptr<UniformRandomVariable> startTime = CreateObject<UniformRandomVariable>();
-        startTime->SetAttribute("Min", DoubleValue(2.0));
-        startTime->SetAttribute("Max", DoubleValue(7.0));
+            Ptr<UniformRandomVariable> startTime = CreateObject<UniformRandomVariable>();
+            startTime->SetAttribute("Min", DoubleValue(2.0));
+            startTime->SetAttribute("Max", DoubleValue(7.0));
 
-        clientApps.Start(Seconds(startTime->GetValue()));
-        clientApps.Stop(Seconds(20.0));
+            clientApps.Start(Seconds(startTime->GetValue()));
+            clientApps.Stop(Seconds(20.0));
+        }
     }
 
-    Simulator::Stop(Seconds(20.0));
+    TraceEchoRtt(allClients, rttCsv);
+
+    Simulator::Stop(Seconds(stopTime));
+    auto wallStart = std::chrono::steady_clock::now();
+    double setupSeconds = std::chrono::duration<double>(wallStart - setupStart).count();
     Simulator::Run();
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    UncachedOut() << "Scale: " << nClients << " clients, " << routing << " routing, setup " << setupSeconds
+                  << " s, run " << wallSeconds << " s wall-clock, peak RSS " << usage.ru_maxrss << " kB" << std::endl;
+    UncachedOut() << "PARSE_SCALE,lab1-part1," << nClients << ",0,1," << setupSeconds << "," << wallSeconds << ","
+                  << usage.ru_maxrss << std::endl;
+    PrintSchedulerStats(scheduler, "lab1-part1," + std::to_string(nClients) + ",0", wallSeconds);
+    PrintEchoRtt("lab1-part1," + std::to_string(nClients) + ",0");
+    if (loadRate > 0) {
+        PrintLoadReport("lab1-part1," + std::to_string(nClients) + ",0", nClients);
+    }
+    StoreCachedResult();
     Simulator::Destroy();
 
     return 0;
@@ -1,3 +1,20 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
 #include "ns3/csma-module.h"
@@ -5,22 +22,83 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/applications-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/flow-monitor-module.h"
+// NeighborCacheHelper (--staticArp) was added in ns-3.37
+#if __has_include("ns3/neighbor-cache-helper.h")
+#include "ns3/neighbor-cache-helper.h"
+#define LAB1_NEIGHBOR_CACHE_HELPER 1
+#endif
+#include "echo-rtt.h"
+#include "result-cache.h"
+#include "scheduler.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Lab1Part2");
 
+// Revision of this program's output, the first line of its --cacheDir result
+// key; result-cache.h adds the build of the program and of ns-3.
+static const char *kResultCacheVersion = "lab1-part2 r1";
+
+// --capture=flow-stats: per-flow delay, jitter, loss and throughput from an
+// in-memory FlowMonitor, instead of writing every packet to pcap files.
+static void
+PrintFlowStats (FlowMonitorHelper &flowHelper, Ptr<FlowMonitor> monitor, std::string tag)
+{
+    monitor->CheckForLostPackets ();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+    for (const auto &entry : monitor->GetFlowStats ())
+    {
+        const FlowMonitor::FlowStats &st = entry.second;
+        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (entry.first);
+        double delayMs = st.rxPackets > 0 ? st.delaySum.GetSeconds () * 1000 / st.rxPackets : 0.0;
+        double jitterMs = st.rxPackets > 1 ? st.jitterSum.GetSeconds () * 1000 / (st.rxPackets - 1) : 0.0;
+        double loss = st.txPackets > 0 ? 1.0 - static_cast<double> (st.rxPackets) / st.txPackets : 0.0;
+        double active = (st.timeLastRxPacket - st.timeFirstTxPacket).GetSeconds ();
+        double kbps = active > 0 ? st.rxBytes * 8.0 / active / 1000 : 0.0;
+        std::cout << "Flow " << entry.first << " (" << t.sourceAddress << ":" << t.sourcePort << " -> "
+                  << t.destinationAddress << ":" << t.destinationPort << "): " << st.rxPackets << "/"
+                  << st.txPackets << " packets, loss " << loss * 100 << "%, delay " << delayMs << " ms, jitter "
+                  << jitterMs << " ms, throughput " << kbps << " kbps" << std::endl;
+        std::cout << "PARSE_FLOW," << tag << "," << entry.first << "," << st.txPackets << "," << st.rxPackets
+                  << "," << loss << "," << delayMs << "," << jitterMs << "," << kbps << std::endl;
+    }
+}
+
 int main (int argc, char *argv[])
 {
-    bool verbose = true;
+    bool verbose = false;
+    std::string rttCsv = "";
     uint32_t nCsma = 3;
     uint32_t nPackets = 1;
+    std::string scheduler = "map";
+    std::string cacheDir = "";
+    std::string capture = "none";
+    bool staticArp = false;
 
     CommandLine cmd;
     cmd.AddValue ("nCsma", "Number of extra CSMA nodes", nCsma);
     cmd.AddValue ("nPackets", "Number of packets sent by the client", nPackets);
-    cmd.AddValue ("verbose", "Enable echo application logs", verbose);
+    cmd.AddValue ("verbose", "Enable the echo applications' INFO logs (slow; RTTs are collected without them)", verbose);
+    cmd.AddValue ("rttCsv", "Also write every echo RTT to this CSV (client,tx_s,rtt_ms); empty disables", rttCsv);
+    cmd.AddValue ("capture", "Packet capture: none, flow-stats (per-flow delay, jitter, loss and throughput) or pcap", capture);
+    cmd.AddValue ("staticArp", "Pre-populate every ARP cache at setup instead of resolving on first use (ns-3.37 or later)", staticArp);
+    cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or priorityqueue", scheduler);
+    cmd.AddValue ("cacheDir", "Reuse results of identical runs stored in this directory (safe to share between parallel runs); empty disables. Runs writing pcap or RTT CSV files bypass it; timings are never cached", cacheDir);
     cmd.Parse (argc, argv);
+    SetScheduler (scheduler);
+
+    NS_ABORT_MSG_UNLESS (capture == "none" || capture == "flow-stats" || capture == "pcap",
+                         "Unknown capture mode " << capture);
+#ifndef LAB1_NEIGHBOR_CACHE_HELPER
+    NS_ABORT_MSG_IF (staticArp, "staticArp needs NeighborCacheHelper, which ns-3.37 added");
+#endif
+    // Pcap and RTT CSV files are not stored, so runs writing them always simulate
+    bool cacheable = !cacheDir.empty () && capture != "pcap" && rttCsv.empty ();
+    if (cacheable && LookupCachedResult (cacheDir, ResultCacheKey (kResultCacheVersion, argc, argv)))
+    {
+        return 0;
+    }
 
     if (verbose)
     {
@@ -64,7 +142,15 @@ int main (int argc, char *argv[])
     address.SetBase ("10.1.1.0", "255.255.255.0");
     Ipv4InterfaceContainer p2pInterfaces = address.Assign (p2pDevices);
 
-    address.SetBase ("10.1.2.0", "255.255.255.0");
+    // A /24 holds 253 CSMA nodes plus the router; larger segments get a /16
+    if (nCsma < 254)
+    {
+        address.SetBase ("10.1.2.0", "255.255.255.0");
+    }
+    else
+    {
+        address.SetBase ("10.2.0.0", "255.255.0.0");
+    }
     Ipv4InterfaceContainer csmaInterfaces = address.Assign (csmaDevices);
 
     address.SetBase ("10.1.3.0", "255.255.255.0");
@@ -83,14 +169,50 @@ int main (int argc, char *argv[])
     ApplicationContainer clientApps = echoClient.Install (p2pNodes.Get (0));
     clientApps.Start (Seconds (2.0));
     clientApps.Stop (Seconds (2.0 + nPackets * 1.0 + 2.0));
+    TraceEchoRtt (clientApps, rttCsv);
 
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
-    p2p.EnablePcapAll ("lab1-part2-p2p");
-    csma.EnablePcap ("lab1-part2-csma", csmaDevices.Get (1), true);
-    p2p.EnablePcap ("lab1-part2-server-p2p", p2pServerDevices.Get (0), true);
+    // Without this the first echo waits for ARP, and every request on the
+    // CSMA segment is a broadcast delivered to all nCsma nodes.
+#ifdef LAB1_NEIGHBOR_CACHE_HELPER
+    if (staticArp)
+    {
+        NeighborCacheHelper neighborCache;
+        neighborCache.PopulateNeighborCache ();
+    }
+#endif
+
+    FlowMonitorHelper flowHelper;
+    Ptr<FlowMonitor> flowMonitor;
+    if (capture == "pcap")
+    {
+        p2p.EnablePcapAll ("lab1-part2-p2p");
+        csma.EnablePcap ("lab1-part2-csma", csmaDevices.Get (1), true);
+        p2p.EnablePcap ("lab1-part2-server-p2p", p2pServerDevices.Get (0), true);
+    }
+    else if (capture == "flow-stats")
+    {
+        flowMonitor = flowHelper.InstallAll ();
+    }
 
+    auto wallStart = std::chrono::steady_clock::now ();
     Simulator::Run ();
+    double wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - wallStart).count ();
+    PrintSchedulerStats (scheduler, "lab1-part2," + std::to_string (nCsma) + ",0", wallSeconds);
+    uint64_t events = Simulator::GetEventCount ();
+    PrintEchoRtt ("lab1-part2," + std::to_string (nCsma) + ",0");
+    // A benchmark line (it carries the wall-clock), so never cached
+    UncachedOut () << "ARP " << (staticArp ? "pre-populated" : "dynamic") << ": " << events << " events, "
+                   << wallSeconds << " s wall-clock, first echo RTT " << echoRtt.firstUs[0] / 1000 << " ms"
+                   << std::endl;
+    UncachedOut () << "PARSE_ARP,lab1-part2," << nCsma << ",0," << staticArp << "," << events << ","
+                   << wallSeconds << "," << echoRtt.firstUs[0] / 1000 << std::endl;
+    if (flowMonitor)
+    {
+        PrintFlowStats (flowHelper, flowMonitor, "lab1-part2," + std::to_string (nCsma) + ",0");
+    }
+    StoreCachedResult ();
     Simulator::Destroy ();
     return 0;
 }
\ No newline at end of file
@@ -1,3 +1,20 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "ns3/applications-module.h"
 #include "ns3/core-module.h"
 #include "ns3/internet-module.h"
@@ -5,22 +22,73 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/wifi-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/flow-monitor-module.h"
+#include "echo-rtt.h"
+#include "result-cache.h"
+#include "scheduler.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Lab1Part3");
 
+// Revision of this program's output, the first line of its --cacheDir result
+// key; result-cache.h adds the build of the program and of ns-3.
+static const char *kResultCacheVersion = "lab1-part3 r1";
+
+// --capture=flow-stats: per-flow delay, jitter, loss and throughput from an
+// in-memory FlowMonitor, instead of writing every packet to pcap files.
+static void
+PrintFlowStats (FlowMonitorHelper &flowHelper, Ptr<FlowMonitor> monitor, std::string tag)
+{
+    monitor->CheckForLostPackets ();
+    Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (flowHelper.GetClassifier ());
+    for (const auto &entry : monitor->GetFlowStats ())
+    {
+        const FlowMonitor::FlowStats &st = entry.second;
+        Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (entry.first);
+        double delayMs = st.rxPackets > 0 ? st.delaySum.GetSeconds () * 1000 / st.rxPackets : 0.0;
+        double jitterMs = st.rxPackets > 1 ? st.jitterSum.GetSeconds () * 1000 / (st.rxPackets - 1) : 0.0;
+        double loss = st.txPackets > 0 ? 1.0 - static_cast<double> (st.rxPackets) / st.txPackets : 0.0;
+        double active = (st.timeLastRxPacket - st.timeFirstTxPacket).GetSeconds ();
+        double kbps = active > 0 ? st.rxBytes * 8.0 / active / 1000 : 0.0;
+        std::cout << "Flow " << entry.first << " (" << t.sourceAddress << ":" << t.sourcePort << " -> "
+                  << t.destinationAddress << ":" << t.destinationPort << "): " << st.rxPackets << "/"
+                  << st.txPackets << " packets, loss " << loss * 100 << "%, delay " << delayMs << " ms, jitter "
+                  << jitterMs << " ms, throughput " << kbps << " kbps" << std::endl;
+        std::cout << "PARSE_FLOW," << tag << "," << entry.first << "," << st.txPackets << "," << st.rxPackets
+                  << "," << loss << "," << delayMs << "," << jitterMs << "," << kbps << std::endl;
+    }
+}
+
 int main (int argc, char *argv[])
 {
     uint32_t nWifi = 4;
     uint32_t nPackets = 10;
-    bool verbose = true;
+    bool verbose = false;
+    std::string rttCsv = "";
+    std::string scheduler = "map";
+    std::string cacheDir = "";
+    std::string capture = "none";
     
     CommandLine cmd;
     cmd.AddValue ("nWifi", "Number of wifi STA nodes per network", nWifi);
     cmd.AddValue ("nPackets", "Number of packets to send", nPackets);
-    cmd.AddValue ("verbose", "Enable logging", verbose);
+    cmd.AddValue ("verbose", "Enable the echo applications' INFO logs (slow; RTTs are collected without them)", verbose);
+    cmd.AddValue ("rttCsv", "Also write every echo RTT to this CSV (client,tx_s,rtt_ms); empty disables", rttCsv);
+    cmd.AddValue ("capture", "Packet capture: none, flow-stats (per-flow delay, jitter, loss and throughput) or pcap", capture);
+    cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or priorityqueue", scheduler);
+    cmd.AddValue ("cacheDir", "Reuse results of identical runs stored in this directory (safe to share between parallel runs); empty disables. Runs writing pcap or RTT CSV files bypass it; timings are never cached", cacheDir);
     cmd.Parse (argc,argv);
+    SetScheduler (scheduler);
+
+    NS_ABORT_MSG_UNLESS (capture == "none" || capture == "flow-stats" || capture == "pcap",
+                         "Unknown capture mode " << capture);
+    // Pcap and RTT CSV files are not stored, so runs writing them always simulate
+    bool cacheable = !cacheDir.empty () && capture != "pcap" && rttCsv.empty ();
+    if (cacheable && LookupCachedResult (cacheDir, ResultCacheKey (kResultCacheVersion, argc, argv)))
+    {
+        return 0;
+    }
 
     if (nWifi > 9) nWifi = 9;
     if (nPackets > 20) nPackets = 20;
@@ -126,15 +194,34 @@ int main (int argc, char *argv[])
     serverApps.Stop (Seconds (simulationTime));
     clientApps.Start (Seconds (2.0));
     clientApps.Stop (Seconds (simulationTime));
+    TraceEchoRtt (clientApps, rttCsv);
 
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
     Simulator::Stop (Seconds (simulationTime));
 
-    pointToPoint.EnablePcapAll ("lab1-part3");
-    phy1.EnablePcap ("lab1-part3", apDevices1.Get (0));
-    phy2.EnablePcap ("lab1-part3", apDevices2.Get (0));
+    FlowMonitorHelper flowHelper;
+    Ptr<FlowMonitor> flowMonitor;
+    if (capture == "pcap")
+    {
+        pointToPoint.EnablePcapAll ("lab1-part3");
+        phy1.EnablePcap ("lab1-part3", apDevices1.Get (0));
+        phy2.EnablePcap ("lab1-part3", apDevices2.Get (0));
+    }
+    else if (capture == "flow-stats")
+    {
+        flowMonitor = flowHelper.InstallAll ();
+    }
 
+    auto wallStart = std::chrono::steady_clock::now ();
     Simulator::Run ();
+    double wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - wallStart).count ();
+    PrintSchedulerStats (scheduler, "lab1-part3," + std::to_string (nWifi) + ",0", wallSeconds);
+    PrintEchoRtt ("lab1-part3," + std::to_string (nWifi) + ",0");
+    if (flowMonitor)
+    {
+        PrintFlowStats (flowHelper, flowMonitor, "lab1-part3," + std::to_string (nWifi) + ",0");
+    }
+    StoreCachedResult ();
     Simulator::Destroy ();
     return 0;
 }
\ No newline at end of file
@@ -1,7 +1,21 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <memory>
+#include <cstdlib>
 #include <map>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -11,89 +25,541 @@
 #include "ns3/error-model.h"
 #include "ns3/tcp-header.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/traffic-control-module.h"
 #include "ns3/netanim-module.h"
+#include "log-histogram.h"
+#include "result-cache.h"
+#include "scheduler.h"
+#include "dumbbell-setup.h"
+#include "flow-goodput.h"
+#include "queue-telemetry.h"
+#include "tcp-trace.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Lab2Part1");
 
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> cWndStream;
-static std::map<uint32_t, bool> firstCwnd;
+static const uint32_t kNoFlow = std::numeric_limits<uint32_t>::max ();
+static std::vector<uint64_t> flowRx;
+static std::vector<uint32_t> portToFlow;
 
-static std::pair<uint32_t, uint32_t>
-GetIdsFromContext (std::string context)
+static uint64_t
+FlowRx (std::size_t flow)
 {
-    std::size_t const n1 = context.find_first_of ("/", 1);
-    std::size_t const n2 = context.find_first_of ("/", n1 + 1);
-    uint32_t nodeId = std::stoul (context.substr (n1 + 1, n2 - n1 - 1));
+    return flowRx[flow];
+}
 
-    std::size_t const s1 = context.find ("SocketList/");
-    if (s1 == std::string::npos)
+// All sources live on node 0, so their ephemeral ports identify the flows
+// arriving at a shared sink.
+static void
+MapSourcePorts (ApplicationContainer sources)
+{
+    for (uint32_t i = 0; i < sources.GetN (); ++i)
     {
-        return {nodeId, 0};
+        Address local;
+        DynamicCast<BulkSendApplication> (sources.Get (i))->GetSocket ()->GetSockName (local);
+        portToFlow[InetSocketAddress::ConvertFrom (local).GetPort ()] = i;
     }
-    std::size_t const s2 = context.find ("/", s1 + 11);
-    uint32_t socketId = std::stoul (context.substr (s1 + 11, s2 - (s1 + 11)));
+}
 
-    return {nodeId, socketId};
+static void
+SinkRx (Ptr<const Packet> packet, const Address &from)
+{
+    ProfileScope scope (kProfileSinkRx);
+    uint32_t flow = portToFlow[InetSocketAddress::ConvertFrom (from).GetPort ()];
+    if (flow != kNoFlow)
+    {
+        flowRx[flow] += packet->GetSize ();
+    }
 }
 
+// With one flow per sink the sink itself identifies the flow, so no source
+// port lookup is needed (and --mpi, where the sources are on another rank,
+// works).
 static void
-CwndTracer (std::string context, uint32_t oldval, uint32_t newval)
+SinkRxFlow (uint32_t flow, Ptr<const Packet> packet, const Address &from)
+{
+    ProfileScope scope (kProfileSinkRx);
+    flowRx[flow] += packet->GetSize ();
+}
+
+// Forks a child that switches every node to 'tid', simulates and writes the
+// per-flow received bytes back. The parent runs its own variant meanwhile and
+// then collects the child's result with CollectForkedVariant.
+static std::pair<pid_t, int>
+ForkVariant (NodeContainer nodes, TypeId tid, double stopTime)
 {
-    std::pair<uint32_t, uint32_t> ids = GetIdsFromContext (context);
-    uint32_t mapId = ids.first * 1000 + ids.second;
+    int fds[2];
+    NS_ABORT_MSG_UNLESS (pipe (fds) == 0, "pipe() failed");
+    std::cout.flush ();
+    std::clog.flush ();
+    pid_t pid = fork ();
+    NS_ABORT_MSG_UNLESS (pid >= 0, "fork() failed");
+    if (pid == 0)
+    {
+        close (fds[0]);
+        SetTcpSocketType (nodes, tid);
+        Simulator::Stop (Seconds (stopTime));
+        Simulator::Run ();
+        const char *data = reinterpret_cast<const char *> (flowRx.data ());
+        std::size_t left = flowRx.size () * sizeof (uint64_t);
+        while (left > 0)
+        {
+            ssize_t n = write (fds[1], data, left);
+            if (n <= 0)
+            {
+                _exit (1);
+            }
+            data += n;
+            left -= n;
+        }
+        _exit (0);
+    }
+    close (fds[1]);
+    return {pid, fds[0]};
+}
 
-    if (firstCwnd.find (mapId) == firstCwnd.end ())
+static std::vector<uint64_t>
+CollectForkedVariant (std::pair<pid_t, int> child, uint32_t nFlows)
+{
+    std::vector<uint64_t> rx (nFlows);
+    char *data = reinterpret_cast<char *> (rx.data ());
+    std::size_t left = rx.size () * sizeof (uint64_t);
+    while (left > 0)
     {
-        firstCwnd[mapId] = true;
+        ssize_t n = read (child.second, data, left);
+        if (n <= 0)
+        {
+            break;
+        }
+        data += n;
+        left -= n;
     }
+    close (child.second);
+    int status = 0;
+    waitpid (child.first, &status, 0);
+    NS_ABORT_MSG_UNLESS (left == 0 && WIFEXITED (status) && WEXITSTATUS (status) == 0,
+                         "Comparison child " << child.first << " failed");
+    return rx;
+}
 
-    if (firstCwnd[mapId])
+// One flow class here, so the share ratio is the best flow's goodput over the
+// mean, i.e. how far the window's winner is above its fair share.
+static double
+BestShareRatio (const std::vector<double> &goodput)
+{
+    double sum = 0.0;
+    double best = 0.0;
+    for (double g : goodput)
     {
-        *cWndStream[mapId]->GetStream () << "0.0 " << oldval << std::endl;
-        firstCwnd[mapId] = false;
+        sum += g;
+        best = std::max (best, g);
     }
-    *cWndStream[mapId]->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+    return sum > 0 ? best * goodput.size () / sum : std::numeric_limits<double>::infinity ();
+}
+
+static const int64_t kWorkloadStream = 2000;
+static const uint64_t kFctBucketLimits[] = {10000, 100000, 1000000, 10000000};
+static const char *kFctBucketNames[] = {"<10KB", "10KB-100KB", "100KB-1MB", "1MB-10MB", ">=10MB"};
+
+struct FctFlow
+{
+    Ptr<Socket> socket;
+    uint16_t port = 0;
+    uint64_t size = 0;
+    uint64_t sent = 0;
+    uint64_t received = 0;
+    Time start;
+};
+
+// Short-flow workload: Poisson arrivals, sizes from an empirical CDF. Slots
+// and their source ports are recycled as flows complete, so state is bounded
+// by the number of flows in flight rather than the number started.
+struct FctWorkload
+{
+    std::vector<FctFlow> slots;
+    std::vector<uint32_t> freeSlots;
+    std::vector<uint32_t> portToSlot;
+    std::vector<std::pair<double, double>> cdf;
+    Ptr<ExponentialRandomVariable> interArrival;
+    Ptr<UniformRandomVariable> sizeDraw;
+    Ptr<Node> source;
+    Address sinkAddress;
+    uint32_t segmentSize = 0;
+    Time stopTime;
+    uint64_t started = 0;
+    uint64_t completed = 0;
+    uint64_t failed = 0;
+    LogHistogram fctUs[sizeof (kFctBucketNames) / sizeof (kFctBucketNames[0])];
+};
+
+static FctWorkload fct;
+
+// "websearch" (DCTCP) and "datamining" (VL2) are the usual datacenter flow
+// size distributions; anything else is read as "<bytes> <cumulative prob>" lines.
+static std::vector<std::pair<double, double>>
+LoadFlowSizeCdf (std::string name)
+{
+    if (name == "websearch")
+    {
+        return {{0, 0}, {10000, 0.15}, {20000, 0.2}, {30000, 0.3}, {50000, 0.4}, {80000, 0.53},
+                {200000, 0.6}, {1000000, 0.7}, {2000000, 0.8}, {5000000, 0.9}, {10000000, 0.97},
+                {30000000, 1.0}};
+    }
+    if (name == "datamining")
+    {
+        return {{0, 0}, {180, 0.1}, {216, 0.2}, {560, 0.3}, {900, 0.4}, {1100, 0.5}, {1870, 0.6},
+                {3160, 0.7}, {10000, 0.8}, {400000, 0.9}, {3160000, 0.95}, {100000000, 0.98},
+                {1000000000, 1.0}};
+    }
+    std::ifstream in (name);
+    NS_ABORT_MSG_UNLESS (in, "Cannot open flow size CDF " << name);
+    std::vector<std::pair<double, double>> cdf;
+    double size;
+    double prob;
+    while (in >> size >> prob)
+    {
+        NS_ABORT_MSG_UNLESS (cdf.empty () || (size >= cdf.back ().first && prob >= cdf.back ().second),
+                             "Flow size CDF " << name << " must be non-decreasing");
+        cdf.push_back ({size, prob});
+    }
+    NS_ABORT_MSG_UNLESS (cdf.size () >= 2 && cdf.back ().second == 1.0,
+                         "Flow size CDF " << name << " must end at probability 1");
+    return cdf;
+}
+
+static uint64_t
+DrawFlowSize ()
+{
+    double u = fct.sizeDraw->GetValue ();
+    std::size_t i = 1;
+    while (i + 1 < fct.cdf.size () && fct.cdf[i].second < u)
+    {
+        ++i;
+    }
+    const std::pair<double, double> &lo = fct.cdf[i - 1];
+    const std::pair<double, double> &hi = fct.cdf[i];
+    double span = hi.second - lo.second;
+    double size = span > 0 ? lo.first + (u - lo.second) / span * (hi.first - lo.first) : hi.first;
+    return std::max<uint64_t> (1, static_cast<uint64_t> (size));
 }
 
 static void
-TraceCwnd (std::string cwnd_tr_file_name, uint32_t nodeId, uint32_t socketId)
+FctSend (uint32_t slot, Ptr<Socket> socket, uint32_t available)
 {
-    uint32_t mapId = nodeId * 1000 + socketId;
-    AsciiTraceHelper ascii;
-    cWndStream[mapId] = ascii.CreateFileStream (cwnd_tr_file_name);
-    
-    Config::Connect ("/NodeList/" + std::to_string (nodeId) +
-                     "/$ns3::TcpL4Protocol/SocketList/" + std::to_string (socketId) +
-                     "/CongestionWindow",
-                     MakeCallback (&CwndTracer));
+    FctFlow &flow = fct.slots[slot];
+    while (flow.sent < flow.size && socket->GetTxAvailable () > 0)
+    {
+        uint32_t chunk = static_cast<uint32_t> (std::min<uint64_t> (
+            {flow.size - flow.sent, socket->GetTxAvailable (), fct.segmentSize}));
+        int sent = socket->Send (Create<Packet> (chunk));
+        if (sent <= 0)
+        {
+            return;
+        }
+        flow.sent += sent;
+    }
+    if (flow.sent == flow.size)
+    {
+        socket->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+        socket->Close ();
+    }
+}
+
+static void
+FctConnected (uint32_t slot, Ptr<Socket> socket)
+{
+    FctSend (slot, socket, socket->GetTxAvailable ());
+}
+
+// The flow never starts, so it has no FCT: count it and recycle its slot.
+static void
+FctConnectFailed (uint32_t slot, Ptr<Socket> socket)
+{
+    NS_LOG_WARN ("FCT flow in slot " << slot << " failed to connect");
+    FctFlow &flow = fct.slots[slot];
+    socket->SetSendCallback (MakeNullCallback<void, Ptr<Socket>, uint32_t> ());
+    socket->Close ();
+    ++fct.failed;
+    fct.portToSlot[flow.port] = kNoFlow;
+    flow.socket = nullptr;
+    fct.freeSlots.push_back (slot);
+}
+
+static void
+FctArrival ()
+{
+    ProfileScope scope (kProfileFct);
+    if (Simulator::Now () >= fct.stopTime)
+    {
+        return;
+    }
+    uint32_t slot;
+    if (!fct.freeSlots.empty ())
+    {
+        slot = fct.freeSlots.back ();
+        fct.freeSlots.pop_back ();
+    }
+    else
+    {
+        slot = fct.slots.size ();
+        fct.slots.emplace_back ();
+    }
+    FctFlow &flow = fct.slots[slot];
+    flow.size = DrawFlowSize ();
+    flow.sent = 0;
+    flow.received = 0;
+    flow.start = Simulator::Now ();
+    flow.socket = Socket::CreateSocket (fct.source, TcpSocketFactory::GetTypeId ());
+    flow.socket->Bind ();
+    Address local;
+    flow.socket->GetSockName (local);
+    flow.port = InetSocketAddress::ConvertFrom (local).GetPort ();
+    fct.portToSlot[flow.port] = slot;
+    flow.socket->SetConnectCallback (MakeBoundCallback (&FctConnected, slot),
+                                     MakeBoundCallback (&FctConnectFailed, slot));
+    flow.socket->SetSendCallback (MakeBoundCallback (&FctSend, slot));
+    flow.socket->Connect (fct.sinkAddress);
+    ++fct.started;
+
+    Simulator::Schedule (Seconds (fct.interArrival->GetValue ()), &FctArrival);
+}
+
+static void
+FctComplete (uint16_t port, uint32_t slot)
+{
+    FctFlow &flow = fct.slots[slot];
+    std::size_t bucket = 0;
+    while (bucket < sizeof (kFctBucketLimits) / sizeof (kFctBucketLimits[0]) && flow.size >= kFctBucketLimits[bucket])
+    {
+        ++bucket;
+    }
+    fct.fctUs[bucket].Add ((Simulator::Now () - flow.start).GetMicroSeconds ());
+    ++fct.completed;
+    fct.portToSlot[port] = kNoFlow;
+    flow.socket = nullptr;
+    fct.freeSlots.push_back (slot);
 }
 
+static void
+FctRecv (Ptr<Socket> socket)
+{
+    ProfileScope scope (kProfileFct);
+    Address from;
+    Ptr<Packet> packet;
+    while ((packet = socket->RecvFrom (from)) && packet->GetSize () > 0)
+    {
+        uint16_t port = InetSocketAddress::ConvertFrom (from).GetPort ();
+        uint32_t slot = fct.portToSlot[port];
+        if (slot == kNoFlow)
+        {
+            continue;
+        }
+        fct.slots[slot].received += packet->GetSize ();
+        if (fct.slots[slot].received >= fct.slots[slot].size)
+        {
+            FctComplete (port, slot);
+        }
+    }
+}
+
+static void
+FctPeerClose (Ptr<Socket> socket)
+{
+    socket->Close ();
+}
+
+static void
+FctAccept (Ptr<Socket> socket, const Address &from)
+{
+    socket->SetRecvCallback (MakeCallback (&FctRecv));
+    socket->SetCloseCallbacks (MakeCallback (&FctPeerClose), MakeCallback (&FctPeerClose));
+}
+
+static void
+SetupFctWorkload (Ptr<Node> source, Ptr<Node> sink, Ipv4Address sinkIp, uint16_t port,
+                  uint32_t segmentSize, double arrivalRate, std::string sizeCdf,
+                  double startTime, double stopTime, bool crn)
+{
+    fct.cdf = LoadFlowSizeCdf (sizeCdf);
+    fct.portToSlot.assign (65536, kNoFlow);
+    fct.source = source;
+    fct.sinkAddress = InetSocketAddress (sinkIp, port);
+    fct.segmentSize = segmentSize;
+    fct.stopTime = Seconds (stopTime);
+    fct.interArrival = CreateObject<ExponentialRandomVariable> ();
+    fct.interArrival->SetAttribute ("Mean", DoubleValue (1.0 / arrivalRate));
+    fct.sizeDraw = CreateObject<UniformRandomVariable> ();
+    if (crn)
+    {
+        fct.interArrival->SetStream (kWorkloadStream);
+        fct.sizeDraw->SetStream (kWorkloadStream + 1);
+    }
+
+    Ptr<Socket> listener = Socket::CreateSocket (sink, TcpSocketFactory::GetTypeId ());
+    listener->Bind (InetSocketAddress (Ipv4Address::GetAny (), port));
+    listener->Listen ();
+    listener->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                                 MakeCallback (&FctAccept));
+
+    Simulator::Schedule (Seconds (startTime), &FctArrival);
+}
+
+static void
+PrintFctReport (std::string transport_prot, std::string sizeCdf, double arrivalRate, uint32_t run)
+{
+    std::cout << std::endl
+              << "------ Lab 2 Part 1 FCT (" << transport_prot << ", " << sizeCdf << ", "
+              << arrivalRate << " flows/s) ------" << std::endl;
+    std::cout << "Flows started: " << fct.started << ", completed: " << fct.completed
+              << ", failed to connect: " << fct.failed << ", peak concurrent: " << fct.slots.size () << std::endl;
+    std::cout << "PARSE_FCT_FLOWS," << transport_prot << "," << fct.started << "," << run << "," << fct.completed
+              << "," << fct.failed << "," << fct.slots.size () << std::endl;
+    for (std::size_t b = 0; b < sizeof (kFctBucketNames) / sizeof (kFctBucketNames[0]); ++b)
+    {
+        const LogHistogram &h = fct.fctUs[b];
+        if (h.total == 0)
+        {
+            continue;
+        }
+        std::cout << kFctBucketNames[b] << ": " << h.total << " flows, FCT p50 " << h.Percentile (50) / 1000
+                  << " ms, p99 " << h.Percentile (99) / 1000 << " ms, p99.9 " << h.Percentile (99.9) / 1000
+                  << " ms" << std::endl;
+        std::cout << "PARSE_FCT," << transport_prot << "," << fct.started << "," << run << ","
+                  << kFctBucketNames[b] << "," << h.total << "," << h.Percentile (50) / 1000 << ","
+                  << h.Percentile (99) / 1000 << "," << h.Percentile (99.9) / 1000 << std::endl;
+    }
+}
+
+// Revision of this program's output, the first line of its --cacheDir result
+// key; result-cache.h adds the build of the program and of ns-3.
+static const char *kResultCacheVersion = "lab2-part1 r1";
+
 int
 main (int argc, char *argv[])
 {  
     std::string dataRate = "1Mbps";
     std::string delay = "20ms";
     double errorRate = 0.00001;
-    uint16_t nFlows = 1;
+    uint32_t nFlows = 1;
+    uint32_t flowsPerSink = 1;
     std::string transport_prot = "TcpNewReno";
+    uint32_t run = 0;
+    bool crn = false;
+    std::string compare_prot = "";
     
     bool tracing = false;
+    std::string traceMode = "buffered";
+    std::string traceFormat = "text";
+    double traceBucket = 0.0;
+    bool probe = false;
+    bool profile = false;
+    std::string scheduler = "map";
     std::string prefix_file_name = "lab2-part1";
     uint32_t mtu_bytes = 1500;
+    uint32_t aggregation = 1;
+    std::string accessRate = "100Mbps";
     uint64_t data_mbytes = 0; 
     double duration = 20.0;
+    std::string queueDisc = "default";
+    std::string queueSize = "100p";
+    bool queueTelemetry = false;
+    std::string workload = "bulk";
+    double flowArrivalRate = 100.0;
+    std::string flowSizeCdf = "websearch";
+    double sampleInterval = 0.0;
+    double warmup = 0.0;
+    double fairnessWindow = 1.0;
+    double steadyTolerance = 0.0;
+    uint32_t steadyWindows = 5;
+    bool mpi = false;
+    std::string cacheDir = "";
 
     CommandLine cmd (__FILE__);
     cmd.AddValue ("dataRate", "Bottleneck link data rate", dataRate);
     cmd.AddValue ("delay", "Bottleneck link delay", delay);
+    cmd.AddValue ("accessRate", "Access link data rate (raise it with multi-gigabit bottlenecks)", accessRate);
+    cmd.AddValue ("mtu", "Link MTU in bytes (e.g. 9000 for jumbo frames)", mtu_bytes);
+    cmd.AddValue ("aggregation", "Send this many segments as one packet (GSO/TSO-like) to cut per-packet events", aggregation);
     cmd.AddValue ("errorRate", "Bottleneck link error rate", errorRate);
-    cmd.AddValue ("nFlows", "Number of flows (max 20)", nFlows);
+    cmd.AddValue ("nFlows", "Number of flows (up to 16383, the ephemeral port range of node 0)", nFlows);
+    cmd.AddValue ("flowsPerSink", "Flows multiplexed onto each sink port", flowsPerSink);
     cmd.AddValue ("transport_prot", "Transport protocol (e.g., TcpCubic, TcpNewReno)", transport_prot);
+    cmd.AddValue ("run", "Run index for RNG stream", run);
+    cmd.AddValue ("crn", "Pin the stack and error-model RNG streams (common random numbers)", crn);
+    cmd.AddValue ("compare", "Also run this TCP variant on the same random streams and report paired differences", compare_prot);
     cmd.AddValue ("tracing", "Flag to enable/disable tracing", tracing);
+    cmd.AddValue ("traceMode", "CWND tracer: buffered or text (per-event flush, for comparison)", traceMode);
+    cmd.AddValue ("traceFormat", "Buffered CWND trace format: text (one .data file per flow) or binary (one <prefix>-cwnd.bin)", traceFormat);
+    cmd.AddValue ("traceBucket", "Aggregate the text CWND trace into buckets of this many simulated seconds (min, max, mean, last, count); 0 writes every update", traceBucket);
+    cmd.AddValue ("probe", "Write <prefix>-flow<i>-probe.data rows of cwnd, ssthresh, RTT, RTO, bytes in flight and congestion state", probe);
+    cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or priorityqueue", scheduler);
+    cmd.AddValue ("profile", "Report event count, events/s, simulated s per wall s, peak RSS and time spent in our callbacks", profile);
     cmd.AddValue ("prefix_name", "Prefix of output trace file", prefix_file_name);
+    cmd.AddValue ("duration", "Simulation duration in seconds", duration);
+    cmd.AddValue ("queueDisc", "Bottleneck queue discipline: default, none, pfifo, red, codel, fqcodel or pie", queueDisc);
+    cmd.AddValue ("queueSize", "Bottleneck queue discipline limit (e.g. 100p, 150000B)", queueSize);
+    cmd.AddValue ("workload", "bulk (nFlows long-lived BulkSend flows) or fct (short flows, reports flow completion times)", workload);
+    cmd.AddValue ("flowArrivalRate", "fct workload: Poisson flow arrival rate in flows/s", flowArrivalRate);
+    cmd.AddValue ("flowSizeCdf", "fct workload: websearch, datamining or a file of '<bytes> <cumulative prob>' lines", flowSizeCdf);
+    cmd.AddValue ("queueStats", "Report bottleneck sojourn-time and queue-length percentiles (implied by queueDisc)", queueTelemetry);
+    cmd.AddValue ("sampleInterval", "Per-flow goodput sampling interval in seconds; 0 disables", sampleInterval);
+    cmd.AddValue ("fairnessWindow", "Sliding window in seconds for the per-window Jain index and share ratios (advanced every quarter window); 0 disables", fairnessWindow);
+    cmd.AddValue ("warmup", "Seconds after the sources start excluded from steady-state goodput", warmup);
+    cmd.AddValue ("steadyTolerance", "Stop once every flow's goodput per sampleInterval window stays within this fraction of its mean over steadyWindows consecutive windows; 0 disables", steadyTolerance);
+    cmd.AddValue ("steadyWindows", "Consecutive windows required by steadyTolerance (at least 2)", steadyWindows);
+    cmd.AddValue ("mpi", "Run senders and receivers on two MPI ranks split at the bottleneck (mpirun -np 2)", mpi);
+    cmd.AddValue ("cacheDir", "Reuse results of identical runs stored in this directory (safe to share between parallel runs); empty disables. Runs writing trace, probe or goodput files and profile runs bypass it; timings are never cached", cacheDir);
     cmd.Parse (argc, argv);
+    auto setupStart = std::chrono::steady_clock::now ();
+
+    NS_ABORT_MSG_UNLESS (traceMode == "buffered" || traceMode == "text",
+                         "Unknown traceMode " << traceMode);
+    NS_ABORT_MSG_UNLESS (traceFormat == "text" || traceFormat == "binary",
+                         "Unknown traceFormat " << traceFormat);
+    NS_ABORT_MSG_IF (traceFormat == "binary" && traceMode == "text",
+                     "traceFormat=binary requires traceMode=buffered");
+    NS_ABORT_MSG_IF (traceBucket > 0 && (traceMode == "text" || traceFormat == "binary"),
+                     "traceBucket requires traceMode=buffered and traceFormat=text");
+    NS_ABORT_MSG_IF (queueTelemetry && queueDisc == "none",
+                     "queueStats needs a queue disc on the bottleneck, which queueDisc=none removes");
+    cwndBucket = Seconds (traceBucket);
+    profiling = profile;
+    NS_ABORT_MSG_IF (mpi && (workload == "fct" || !compare_prot.empty () || steadyTolerance > 0 || flowsPerSink != 1),
+                     "mpi supports the bulk workload with flowsPerSink=1, without compare or steadyTolerance");
+    // --mpi: senders (nodes 0, 1) on rank 0, receivers (nodes 2, 3) on rank 1.
+    uint32_t systemId = mpi ? EnableDistributed (&argc, &argv) : 0;
+    bool senderRank = !mpi || systemId == 0;
+    bool receiverRank = !mpi || systemId == 1;
+    SetScheduler (scheduler);
+
+    NS_ABORT_MSG_IF (tracing && !compare_prot.empty (), "tracing is not supported with compare");
+    NS_ABORT_MSG_IF (tracing && traceFormat == "text" && nFlows > kMaxTraceFiles,
+                     "tracing writes one file per flow; use --traceFormat=binary above " << kMaxTraceFiles << " flows");
+    NS_ABORT_MSG_IF (probe && nFlows > kMaxTraceFiles,
+                     "probe writes one file per flow and is limited to " << kMaxTraceFiles << " flows");
+    NS_ABORT_MSG_IF (probe && !compare_prot.empty (), "probe is not supported with compare");
+    NS_ABORT_MSG_IF (probe && workload == "fct", "probe only applies to the bulk workload");
+    NS_ABORT_MSG_UNLESS (nFlows >= 1 && nFlows <= 16383, "nFlows must be between 1 and 16383");
+    traceFlushBytes = std::max (kTraceMinFlushBytes, kTraceChunkBytes / nFlows);
+    NS_ABORT_MSG_UNLESS (flowsPerSink >= 1, "flowsPerSink must be at least 1");
+    NS_ABORT_MSG_UNLESS (workload == "bulk" || workload == "fct", "Unknown workload " << workload);
+    NS_ABORT_MSG_IF (workload == "fct" && (tracing || sampleInterval > 0 || !compare_prot.empty ()),
+                     "tracing, sampleInterval and compare only apply to the bulk workload");
+    NS_ABORT_MSG_UNLESS (flowArrivalRate > 0, "flowArrivalRate must be positive");
+
+    NS_ABORT_MSG_IF (steadyTolerance > 0 && sampleInterval <= 0, "steadyTolerance requires sampleInterval");
+    NS_ABORT_MSG_IF (steadyTolerance > 0 && steadyWindows < 2, "steadyWindows must be at least 2");
+    NS_ABORT_MSG_IF (steadyTolerance > 0 && !compare_prot.empty (), "steadyTolerance is not supported with compare");
+
+    SeedManager::SetRun (run);
+    // Trace, probe and goodput files are not stored, so runs producing them
+    // always simulate; so do --profile runs, which measure this process.
+    bool cacheable = !cacheDir.empty () && !tracing && !probe && !profile && sampleInterval <= 0 && !mpi;
+    if (cacheable && LookupCachedResult (cacheDir, ResultCacheKey (kResultCacheVersion, argc, argv, "tcp=" + transport_prot)))
+    {
+        return 0;
+    }
 
     transport_prot = std::string ("ns3::") + transport_prot;
 
@@ -102,43 +568,85 @@ main (int argc, char *argv[])
                          "TypeId " << transport_prot << " not found");
     Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (tcpTid));
 
-    Header *temp_header = new Ipv4Header ();
-    uint32_t ip_header = temp_header->GetSerializedSize ();
-    delete temp_header;
-    temp_header = new TcpHeader ();
-    uint32_t tcp_header = temp_header->GetSerializedSize ();
-    delete temp_header;
-    uint32_t tcp_adu_size = mtu_bytes - (ip_header + tcp_header);
+    TypeId compareTid;
+    if (!compare_prot.empty ())
+    {
+        compare_prot = std::string ("ns3::") + compare_prot;
+        NS_ABORT_MSG_UNLESS (TypeId::LookupByNameFailSafe (compare_prot, &compareTid),
+                             "TypeId " << compare_prot << " not found");
+        crn = true;
+    }
+
+    SegmentSizing sizing = SizeSegments (mtu_bytes, aggregation);
+    uint32_t tcp_adu_size = sizing.aduSize;
+    uint32_t link_mtu = sizing.linkMtu;
 
     NS_LOG_INFO ("Create nodes.");
     NodeContainer nodes;
-    nodes.Create (4);
+    if (mpi)
+    {
+        nodes.Create (2, 0);
+        nodes.Create (2, 1);
+    }
+    else
+    {
+        nodes.Create (4);
+    }
     NodeContainer n0n1 = NodeContainer (nodes.Get (0), nodes.Get (1));
     NodeContainer n1n2 = NodeContainer (nodes.Get (1), nodes.Get (2));
     NodeContainer n2n3 = NodeContainer (nodes.Get (2), nodes.Get (3));
 
     NS_LOG_INFO ("Create channels.");
     PointToPointHelper p2pAccess;
-    p2pAccess.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
+    p2pAccess.SetDeviceAttribute ("DataRate", StringValue (accessRate));
+    p2pAccess.SetDeviceAttribute ("Mtu", UintegerValue (link_mtu));
     p2pAccess.SetChannelAttribute ("Delay", StringValue ("0.01ms"));
 
     PointToPointHelper p2pBottleneck;
     p2pBottleneck.SetDeviceAttribute ("DataRate", StringValue (dataRate));
+    p2pBottleneck.SetDeviceAttribute ("Mtu", UintegerValue (link_mtu));
     p2pBottleneck.SetChannelAttribute ("Delay", StringValue (delay));
+    if (queueDisc != "default")
+    {
+        // Keep the device queue minimal so packets wait in the queue disc.
+        p2pBottleneck.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue ("1p"));
+    }
 
+    // RateErrorModel counts errors per byte by default, so larger (jumbo or
+    // aggregated) packets are dropped more often, like a corrupted frame.
+    // Data (received by node 2) and ACKs (received by node 1) share one
+    // model, whose draws interleave both directions. The two ranks of --mpi
+    // cannot reproduce that sequence, so there the ACKs get their own model
+    // and stream, and drop other packets than a sequential run would.
     Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
     em->SetAttribute ("ErrorRate", DoubleValue (errorRate));
-
-    p2pBottleneck.SetDeviceAttribute ("ReceiveErrorModel", PointerValue (em));
+    Ptr<RateErrorModel> emAck = em;
+    if (mpi)
+    {
+        emAck = CreateObject<RateErrorModel> ();
+        emAck->SetAttribute ("ErrorRate", DoubleValue (errorRate));
+    }
 
     NetDeviceContainer d0d1 = p2pAccess.Install (n0n1);
     NetDeviceContainer d1d2 = p2pBottleneck.Install (n1n2);
+    d1d2.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+    d1d2.Get (0)->SetAttribute ("ReceiveErrorModel", PointerValue (emAck));
     NetDeviceContainer d2d3 = p2pAccess.Install (n2n3);
 
     NS_LOG_INFO ("Install internet stack.");
     InternetStackHelper stack;
     stack.Install (nodes);
 
+    if (crn)
+    {
+        stack.AssignStreams (nodes, kStackStream);
+        em->AssignStreams (kErrorModelStream);
+        if (emAck != em)
+        {
+            emAck->AssignStreams (kErrorModelStream + 1);
+        }
+    }
+
     NS_LOG_INFO ("Assign IP Addresses.");
     Ipv4AddressHelper ipv4;
     ipv4.SetBase ("10.1.1.0", "255.255.255.0");
@@ -150,6 +658,9 @@ main (int argc, char *argv[])
     ipv4.SetBase ("10.1.3.0", "255.255.255.0");
     Ipv4InterfaceContainer i2i3 = ipv4.Assign (d2d3);
 
+    NS_LOG_INFO ("Set up the " << queueDisc << " bottleneck queue disc.");
+    Ptr<QueueDisc> bottleneckQueue = SetupBottleneckQueue (queueDisc, queueSize, queueTelemetry, d1d2);
+
     NS_LOG_INFO ("Enable static global routing.");
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
@@ -160,70 +671,257 @@ main (int argc, char *argv[])
     double simStopTime = duration; 
 
     Ipv4Address destAddress = i2i3.GetAddress (1);
+
+    if (workload == "fct")
+    {
+        NS_LOG_INFO ("Create FCT workload.");
+        Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (tcp_adu_size));
+        SetupFctWorkload (nodes.Get (0), nodes.Get (3), destAddress, port, tcp_adu_size,
+                          flowArrivalRate, flowSizeCdf, sourceStartTime, simStopTime, crn);
+
+        NS_LOG_INFO ("Run Simulation.");
+        Simulator::Stop (Seconds (simStopTime));
+        auto fctStart = std::chrono::steady_clock::now ();
+        Simulator::Run ();
+        double fctSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - fctStart).count ();
+        NS_LOG_INFO ("Simulation Done.");
+
+        PrintFctReport (transport_prot, flowSizeCdf, flowArrivalRate, run);
+        PrintSchedulerStats (scheduler, transport_prot + "," + std::to_string (fct.started) + "," + std::to_string (run),
+                             fctSeconds);
+        if (bottleneckQueue)
+        {
+            PrintQueueTelemetry (queueDisc, bottleneckQueue,
+                                 transport_prot + "," + std::to_string (fct.started) + "," + std::to_string (run));
+        }
+        if (profile)
+        {
+            PrintProfile (transport_prot + "," + std::to_string (fct.started) + "," + std::to_string (run), fctSeconds);
+        }
+        std::cout << "----------------------------------------------------" << std::endl;
+
+        StoreCachedResult ();
+        Simulator::Destroy ();
+        return 0;
+    }
     ApplicationContainer sinkApps;
+    ApplicationContainer sourceApps;
+
+    uint32_t nSinks = (nFlows + flowsPerSink - 1) / flowsPerSink;
+    NS_ABORT_MSG_IF (port + nSinks > 65536, "Too many sink ports; raise flowsPerSink");
+    flowRx.assign (nFlows, 0);
+    portToFlow.assign (65536, kNoFlow);
 
     for (uint32_t i = 0; i < nFlows; ++i)
     {
-        Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), port + i));
-        PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", sinkLocalAddress);
-        ApplicationContainer sinkApp = sinkHelper.Install (nodes.Get (3));
-        sinkApp.Start (Seconds (sinkStartTime));
-        sinkApp.Stop (Seconds (simStopTime));
-        sinkApps.Add (sinkApp);
+        uint16_t sinkPort = port + i / flowsPerSink;
+        if (i % flowsPerSink == 0 && receiverRank)
+        {
+            Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), sinkPort));
+            PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", sinkLocalAddress);
+            ApplicationContainer sinkApp = sinkHelper.Install (nodes.Get (3));
+            sinkApp.Start (Seconds (sinkStartTime));
+            sinkApp.Stop (Seconds (simStopTime));
+            if (flowsPerSink == 1)
+            {
+                sinkApp.Get (0)->TraceConnectWithoutContext ("Rx", MakeBoundCallback (&SinkRxFlow, i));
+            }
+            else
+            {
+                sinkApp.Get (0)->TraceConnectWithoutContext ("Rx", MakeCallback (&SinkRx));
+            }
+            sinkApps.Add (sinkApp);
+        }
 
-        Address remoteAddress (InetSocketAddress (destAddress, port + i));
+        Address remoteAddress (InetSocketAddress (destAddress, sinkPort));
         Config::SetDefault ("ns3::TcpSocket::SegmentSize", UintegerValue (tcp_adu_size));
         
         BulkSendHelper sourceHelper ("ns3::TcpSocketFactory", Address ());
         sourceHelper.SetAttribute ("Remote", AddressValue (remoteAddress));
         sourceHelper.SetAttribute ("SendSize", UintegerValue (tcp_adu_size));
         sourceHelper.SetAttribute ("MaxBytes", UintegerValue (data_mbytes));
+        if (!senderRank)
+        {
+            continue;
+        }
 
         ApplicationContainer sourceApp = sourceHelper.Install (nodes.Get (0));
         sourceApp.Start (Seconds (sourceStartTime));
         sourceApp.Stop (Seconds (simStopTime));
+        sourceApps.Add (sourceApp);
+    }
+    if (flowsPerSink > 1)
+    {
+        Simulator::Schedule (Seconds (sourceStartTime + 0.00001), &MapSourcePorts, sourceApps);
     }
 
-    if (tracing)
+    if (tracing && senderRank)
     {
         NS_LOG_INFO ("Enable CWND Tracing.");
-        for (uint32_t i = 0; i < nFlows; ++i)
-        {
-            std::string flowString = "-flow" + std::to_string (i);
-            std::string traceFile = prefix_file_name + flowString + "-cwnd.data";
-            
-            Simulator::Schedule (Seconds (sourceStartTime + 0.00001),
-                                 &TraceCwnd,
-                                 traceFile,
-                                 nodes.Get (0)->GetId(),
-                                 i);
-        }
+        EnableCwndTracing (prefix_file_name, traceMode, traceFormat, nFlows, nodes.Get (0)->GetId (), sourceApps,
+                           sourceStartTime);
+    }
+
+    if (probe && senderRank)
+    {
+        NS_LOG_INFO ("Enable socket probes.");
+        EnableSocketProbes (prefix_file_name, nFlows, sourceApps, sourceStartTime);
+    }
+
+    std::pair<pid_t, int> compareChild;
+    if (!compare_prot.empty ())
+    {
+        NS_LOG_INFO ("Fork " << compare_prot << " comparison run.");
+        compareChild = ForkVariant (nodes, compareTid, simStopTime);
+    }
+
+    if (sampleInterval > 0 && receiverRank)
+    {
+        NS_LOG_INFO ("Enable goodput sampling.");
+        EnableGoodputSampling (nFlows, FlowRx, sampleInterval, sourceStartTime, simStopTime,
+                               sourceStartTime + warmup, steadyTolerance, steadyWindows);
+    }
+
+    if (fairnessWindow > 0 && receiverRank)
+    {
+        NS_LOG_INFO ("Enable sliding-window fairness.");
+        EnableFairnessWindows (nFlows, FlowRx, &BestShareRatio, fairnessWindow, sourceStartTime + warmup);
     }
 
     NS_LOG_INFO ("Run Simulation.");
     Simulator::Stop (Seconds (simStopTime));
+    auto wallStart = std::chrono::steady_clock::now ();
+    double setupSeconds = std::chrono::duration<double> (wallStart - setupStart).count ();
     Simulator::Run ();
+    double wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - wallStart).count ();
     NS_LOG_INFO ("Simulation Done.");
+    if (!receiverRank)
+    {
+        // Sender rank of an --mpi run; goodput is reported by the receiver rank.
+        std::cout << "Rank " << systemId << " (senders): " << Simulator::GetEventCount () << " events, run "
+                  << wallSeconds << " s wall-clock" << std::endl;
+        if (bottleneckQueue)
+        {
+            PrintQueueTelemetry (queueDisc, bottleneckQueue,
+                                 transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run));
+        }
+        if (tracing)
+        {
+            PrintCwndTraceStats (traceMode, traceFormat, wallSeconds);
+        }
+        Simulator::Destroy ();
+        DisableDistributed ();
+        return 0;
+    }
+    if (sampleInterval > 0)
+    {
+        RecordGoodputSample ();
+    }
     
-    double activeTime = simStopTime - sourceStartTime;
+    double activeTime = Simulator::Now ().GetSeconds () - sourceStartTime;
     uint64_t totalRx = 0;
+    std::vector<double> flowGoodput (nFlows);
 
     std::cout << std::endl
               << "------ Lab 2 Part 1 Goodput (" << transport_prot << ") ------" << std::endl;
     for (uint32_t i = 0; i < nFlows; ++i)
     {
-        Ptr<PacketSink> sink = DynamicCast<PacketSink> (sinkApps.Get (i));
-        uint64_t bytesReceived = sink->GetTotalRx ();
+        uint64_t bytesReceived = flowRx[i];
         totalRx += bytesReceived;
 
         double goodput_bps = (bytesReceived * 8.0) / activeTime;
+        flowGoodput[i] = goodput_bps;
         std::cout << "Flow " << i << " (N0->N3): " << bytesReceived << " bytes received, "
                   << "Goodput: " << goodput_bps << " bps" << std::endl;
     }
     double avgGoodput_bps = (totalRx * 8.0) / (nFlows * activeTime);
     std::cout << "Average Flow Goodput: " << avgGoodput_bps << " bps" << std::endl;
+    FairnessSummary fair = fairness.summary;
+    fair.jain = JainIndex (flowGoodput, 0, nFlows);
+    std::cout << "Jain fairness index: " << fair.jain << std::endl;
+    if (fair.windows > 0)
+    {
+        std::cout << "Sliding " << fairnessWindow << " s windows (" << fair.windows << "): Jain min "
+                  << fair.windowJainMin << ", mean " << fair.WindowJainMean () << "; best flow / fair share mean "
+                  << fair.ShareMean () << ", max " << fair.shareMax << std::endl;
+    }
+    std::cout << "PARSE_ME," << transport_prot << "," << nFlows << "," << run << "," << avgGoodput_bps << ","
+              << fair.jain << "," << fair.windows << "," << fair.windowJainMin << "," << fair.WindowJainMean ()
+              << "," << fair.ShareMean () << "," << fair.shareMax << std::endl;
+    if (sampler.stoppedEarly)
+    {
+        std::cout << "Stopped early at " << Simulator::Now ().GetSeconds () << " s (steady state within "
+                  << steadyTolerance << " for " << steadyWindows << " samples)" << std::endl;
+    }
+    if (sampleInterval > 0)
+    {
+        WriteGoodputSeries (prefix_file_name + "-goodput.data");
+        std::vector<double> steady = SteadyStateGoodput (sourceStartTime + warmup);
+        if (steady.empty ())
+        {
+            std::cout << "Steady-state goodput: not enough samples after the warm-up" << std::endl;
+        }
+        else
+        {
+            double steadySum = 0.0;
+            std::cout << "Steady-state goodput (after " << warmup << " s warm-up, "
+                      << sampleInterval << " s samples):" << std::endl;
+            for (uint32_t i = 0; i < nFlows; ++i)
+            {
+                steadySum += steady[i];
+                std::cout << "Steady Flow " << i << ": " << steady[i] << " bps" << std::endl;
+            }
+            std::cout << "Average Steady Flow Goodput: " << steadySum / nFlows << " bps" << std::endl;
+        }
+    }
+    if (!compare_prot.empty ())
+    {
+        std::vector<uint64_t> compareRx = CollectForkedVariant (compareChild, nFlows);
+        uint64_t compareTotalRx = 0;
+        std::cout << "Paired vs " << compare_prot << " (common random numbers, Run " << run << "):" << std::endl;
+        for (uint32_t i = 0; i < nFlows; ++i)
+        {
+            compareTotalRx += compareRx[i];
+            double goodput_bps = (flowRx[i] * 8.0) / activeTime;
+            double compare_bps = (compareRx[i] * 8.0) / activeTime;
+            std::cout << "Flow " << i << " diff: " << goodput_bps - compare_bps << " bps ("
+                      << goodput_bps << " vs " << compare_bps << ")" << std::endl;
+        }
+        double compareAvg_bps = (compareTotalRx * 8.0) / (nFlows * activeTime);
+        std::cout << "Average Flow Goodput diff: " << avgGoodput_bps - compareAvg_bps << " bps" << std::endl;
+        std::cout << "PARSE_DIFF," << transport_prot << "," << nFlows << "," << run << "," << compare_prot << ","
+                  << avgGoodput_bps << "," << compareAvg_bps << "," << avgGoodput_bps - compareAvg_bps << std::endl;
+    }
+    if (bottleneckQueue && senderRank)
+    {
+        PrintQueueTelemetry (queueDisc, bottleneckQueue,
+                             transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run));
+    }
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    UncachedOut () << "Scale: " << nFlows << " flows on " << nSinks << " sinks, setup " << setupSeconds
+                   << " s, run " << wallSeconds << " s wall-clock" << (mpi ? " on 2 MPI ranks" : "")
+                   << ", peak RSS " << usage.ru_maxrss << " kB" << std::endl;
+    UncachedOut () << "PARSE_SCALE," << transport_prot << "," << nFlows << "," << run << "," << nSinks << ","
+                   << setupSeconds << "," << wallSeconds << "," << usage.ru_maxrss << std::endl;
+    PrintSchedulerStats (scheduler, transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run),
+                         wallSeconds);
+    if (tracing && senderRank)
+    {
+        PrintCwndTraceStats (traceMode, traceFormat, wallSeconds);
+    }
+    if (probe && senderRank)
+    {
+        PrintProbeStats (wallSeconds);
+    }
+    if (profile)
+    {
+        PrintProfile (transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run), wallSeconds);
+    }
     std::cout << "----------------------------------------------------" << std::endl;
 
+    StoreCachedResult ();
     Simulator::Destroy ();
+    DisableDistributed ();
     return 0;
 }
\ No newline at end of file
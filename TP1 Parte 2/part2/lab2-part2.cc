@@ -1,7 +1,23 @@
 #include <iostream>
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <memory>
+#include <cstdlib>
 #include <map>
+#include <vector>
+#include <chrono>
+#include <cstdio>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <thread>
+
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
 
 #include "ns3/core-module.h"
 #include "ns3/network-module.h"
@@ -11,57 +27,239 @@
 #include "ns3/error-model.h"
 #include "ns3/tcp-header.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "ns3/traffic-control-module.h"
 
+#include "log-histogram.h"
+#include "result-cache.h"
+#include "scheduler.h"
+#include "dumbbell-setup.h"
+#include "flow-goodput.h"
+#include "queue-telemetry.h"
+#include "tcp-trace.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Lab2Part2");
 
-static std::map<uint32_t, Ptr<OutputStreamWrapper>> cWndStream;
-static std::map<uint32_t, bool> firstCwnd;
-static std::pair<uint32_t, uint32_t>
-GetIdsFromContext (std::string context)
+static double
+AverageGoodput (const ApplicationContainer &sinks, double activeTime)
 {
-    std::size_t const n1 = context.find_first_of ("/", 1);
-    std::size_t const n2 = context.find_first_of ("/", n1 + 1);
-    uint32_t nodeId = std::stoul (context.substr (n1 + 1, n2 - n1 - 1));
-    std::size_t const s1 = context.find ("SocketList/");
-    if (s1 == std::string::npos)
+    uint64_t totalRx = 0;
+    for (uint32_t i = 0; i < sinks.GetN (); ++i)
     {
-        return {nodeId, 0};
+        Ptr<PacketSink> sink = DynamicCast<PacketSink> (sinks.Get (i));
+        totalRx += sink->GetTotalRx ();
     }
-    std::size_t const s2 = context.find ("/", s1 + 11);
-    uint32_t socketId = std::stoul (context.substr (s1 + 11, s2 - (s1 + 11)));
-    return {nodeId, socketId};
+    return (totalRx * 8.0) / (sinks.GetN () * activeTime);
 }
-static void
-CwndTracer (std::string context, uint32_t oldval, uint32_t newval)
+
+// The share ratio of a window is the dest1 (short RTT) aggregate goodput over
+// the dest2 (long RTT) one; windows where dest2 received nothing are skipped.
+static double
+DestShareRatio (const std::vector<double> &goodput)
 {
-    std::pair<uint32_t, uint32_t> ids = GetIdsFromContext (context);
-    uint32_t mapId = ids.first * 1000 + ids.second;
-    if (firstCwnd.find (mapId) == firstCwnd.end ())
+    std::size_t n = goodput.size ();
+    double dest1 = 0.0;
+    double dest2 = 0.0;
+    for (std::size_t i = 0; i < n; ++i)
     {
-        firstCwnd[mapId] = true;
+        (i < n / 2 ? dest1 : dest2) += goodput[i];
     }
-    if (firstCwnd[mapId])
+    return dest2 > 0 ? dest1 / dest2 : std::numeric_limits<double>::infinity ();
+}
+
+// Byte counters of the flows for the sampler and the fairness windows: one
+// sink per flow, in flow order.
+static FlowRxBytes
+SinkRxBytes (const ApplicationContainer &sinks)
+{
+    std::vector<Ptr<PacketSink>> flowSinks;
+    for (uint32_t i = 0; i < sinks.GetN (); ++i)
+    {
+        flowSinks.push_back (DynamicCast<PacketSink> (sinks.Get (i)));
+    }
+    return [flowSinks] (std::size_t flow) { return flowSinks[flow]->GetTotalRx (); };
+}
+
+// Per-flow goodput of the run so far (one sink per flow, in flow order) and
+// the final Jain indices, globally and within each RTT group.
+static std::vector<double>
+FlowGoodput (const ApplicationContainer &sinks, double activeTime)
+{
+    std::vector<double> goodput (sinks.GetN ());
+    for (uint32_t i = 0; i < sinks.GetN (); ++i)
     {
-        *cWndStream[mapId]->GetStream () << "0.0 " << oldval << std::endl;
-        firstCwnd[mapId] = false;
+        goodput[i] = DynamicCast<PacketSink> (sinks.Get (i))->GetTotalRx () * 8.0 / activeTime;
     }
-    *cWndStream[mapId]->GetStream () << Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+    return goodput;
 }
+
+static FairnessSummary
+SummarizeFairness (const std::vector<double> &goodput)
+{
+    FairnessSummary summary = fairness.summary;
+    std::size_t n = goodput.size ();
+    summary.jain = JainIndex (goodput, 0, n);
+    summary.jainDest1 = JainIndex (goodput, 0, n / 2);
+    summary.jainDest2 = JainIndex (goodput, n / 2, n);
+    return summary;
+}
+
 static void
-TraceCwnd (std::string cwnd_tr_file_name, uint32_t nodeId, uint32_t socketId)
+PrintParseMe (std::string prot, uint32_t nFlows, uint32_t run, double dest1, double dest2,
+              const FairnessSummary &fair)
+{
+    std::cout << "PARSE_ME," << prot << "," << nFlows << "," << run << "," << dest1 << "," << dest2 << ","
+              << fair.jain << "," << fair.jainDest1 << "," << fair.jainDest2 << "," << fair.windows << ","
+              << fair.windowJainMin << "," << fair.WindowJainMean () << ","
+              << (fair.shares > 0 ? fair.shareMin : 0.0) << "," << fair.ShareMean () << "," << fair.shareMax
+              << std::endl;
+}
+
+// Variant 0 is transport_prot, variant 1 the --compare protocol.
+struct ReplicationTask
+{
+    uint32_t run;
+    uint32_t variant;
+};
+
+struct ReplicationResult
+{
+    uint32_t run;
+    uint32_t variant;
+    double goodputDest1;
+    double goodputDest2;
+    FairnessSummary fairness;
+};
+
+struct ReplicationStats
+{
+    uint32_t n = 0;
+    double sum = 0.0;
+    double sumSq = 0.0;
+
+    void Add (double x)
+    {
+        ++n;
+        sum += x;
+        sumSq += x * x;
+    }
+
+    double Mean () const
+    {
+        return n > 0 ? sum / n : 0.0;
+    }
+
+    double RelativeHalfWidth95 () const
+    {
+        double mean = std::fabs (Mean ());
+        double hw = HalfWidth95 ();
+        if (mean == 0.0)
+        {
+            return hw == 0.0 ? 0.0 : std::numeric_limits<double>::infinity ();
+        }
+        return hw / mean;
+    }
+
+    // At least minRuns (and two) samples, whose relative half-width is
+    // within relWidth. HalfWidth95 () is 0 below two samples, so n alone
+    // must rule out convergence on no data.
+    bool Converged (double relWidth, uint32_t minRuns) const
+    {
+        return n >= std::max (2u, minRuns) && RelativeHalfWidth95 () <= relWidth;
+    }
+
+    // Total runs after which RelativeHalfWidth95 () should reach relWidth,
+    // extrapolating the current half-width as shrinking with 1/sqrt (n).
+    uint32_t RunsFor (double relWidth) const
+    {
+        double rel = RelativeHalfWidth95 ();
+        if (rel <= relWidth)
+        {
+            return n;
+        }
+        double runs = std::ceil (n * (rel / relWidth) * (rel / relWidth));
+        return runs < std::numeric_limits<uint32_t>::max () ? static_cast<uint32_t> (runs)
+                                                           : std::numeric_limits<uint32_t>::max ();
+    }
+
+    // Half width of the 95% Student-t confidence interval of the mean.
+    double HalfWidth95 () const
+    {
+        static const double t975[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306,
+                                      2.262, 2.228, 2.201, 2.179, 2.160, 2.145, 2.131, 2.120,
+                                      2.110, 2.101, 2.093, 2.086, 2.080, 2.074, 2.069, 2.064,
+                                      2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+        if (n < 2)
+        {
+            return 0.0;
+        }
+        uint32_t df = n - 1;
+        double t = df <= 30 ? t975[df - 1] : 1.96 + 2.5 / df;
+        double var = std::max (0.0, (sumSq - sum * sum / n) / df);
+        return t * std::sqrt (var / n);
+    }
+};
+
+// Forks one child per task from the already built scenario, at most 'jobs' at
+// a time. Each child reseeds, simulates and writes its result over a pipe.
+static std::vector<ReplicationResult>
+ForkReplications (const std::vector<ReplicationTask> &tasks, uint32_t jobs,
+                  std::function<ReplicationResult (ReplicationTask)> simulate)
 {
-    uint32_t mapId = nodeId * 1000 + socketId;
-    AsciiTraceHelper ascii;
-    cWndStream[mapId] = ascii.CreateFileStream (cwnd_tr_file_name);
-    Config::Connect ("/NodeList/" + std::to_string (nodeId) +
-                     "/$ns3::TcpL4Protocol/SocketList/" + std::to_string (socketId) +
-                     "/CongestionWindow",
-                     MakeCallback (&CwndTracer));
+    std::vector<ReplicationResult> results;
+    std::map<pid_t, int> children;
+    std::size_t next = 0;
+
+    while (next < tasks.size () || !children.empty ())
+    {
+        while (next < tasks.size () && children.size () < jobs)
+        {
+            int fds[2];
+            NS_ABORT_MSG_UNLESS (pipe (fds) == 0, "pipe() failed");
+            std::cout.flush ();
+            std::clog.flush ();
+            pid_t pid = fork ();
+            NS_ABORT_MSG_UNLESS (pid >= 0, "fork() failed");
+            if (pid == 0)
+            {
+                close (fds[0]);
+                ReplicationResult result = simulate (tasks[next]);
+                ssize_t written = write (fds[1], &result, sizeof (result));
+                _exit (written == sizeof (result) ? 0 : 1);
+            }
+            close (fds[1]);
+            children[pid] = fds[0];
+            ++next;
+        }
+
+        int status = 0;
+        pid_t pid = wait (&status);
+        auto it = children.find (pid);
+        if (it == children.end ())
+        {
+            continue;
+        }
+        ReplicationResult result;
+        bool ok = WIFEXITED (status) && WEXITSTATUS (status) == 0 &&
+                  read (it->second, &result, sizeof (result)) == sizeof (result);
+        NS_ABORT_MSG_UNLESS (ok, "Replication child " << pid << " failed");
+        results.push_back (result);
+        close (it->second);
+        children.erase (it);
+    }
+
+    std::sort (results.begin (), results.end (),
+               [] (const ReplicationResult &a, const ReplicationResult &b) {
+                   return a.run != b.run ? a.run < b.run : a.variant < b.variant;
+               });
+    return results;
 }
 
+// Revision of this program's output, the first line of its --cacheDir result
+// key; result-cache.h adds the build of the program and of ns-3.
+static const char *kResultCacheVersion = "lab2-part2 r1";
+
 int
 main (int argc, char *argv[])
 {
@@ -71,32 +269,133 @@ main (int argc, char *argv[])
     uint16_t nFlows = 2;
     std::string transport_prot = "TcpNewReno";
     uint32_t run = 0;
+    bool crn = false;
+    std::string compare_prot = "";
 
     bool tracing = false;
+    std::string traceMode = "buffered";
+    std::string traceFormat = "text";
+    double traceBucket = 0.0;
+    bool probe = false;
+    bool profile = false;
+    std::string scheduler = "map";
     std::string prefix_file_name = "lab2-part2";
     uint32_t mtu_bytes = 1500;
+    uint32_t aggregation = 1;
+    std::string accessRate = "100Mbps";
     uint64_t data_mbytes = 0;
     double duration = 20.0;
+    std::string queueDisc = "default";
+    std::string queueSize = "100p";
+    bool queueTelemetry = false;
+    double sampleInterval = 0.0;
+    double warmup = 0.0;
+    double fairnessWindow = 1.0;
+    double steadyTolerance = 0.0;
+    uint32_t steadyWindows = 5;
+    uint32_t replications = 0;
+    double ciWidth = 0.0;
+    uint32_t minRuns = 5;
+    uint32_t maxRuns = 200;
+    uint32_t jobs = std::max (1u, std::thread::hardware_concurrency ());
+    bool mpi = false;
+    std::string cacheDir = "";
 
     CommandLine cmd (__FILE__);
     cmd.AddValue ("dataRate", "Bottleneck link data rate", dataRate);
     cmd.AddValue ("delay", "Bottleneck link delay", delay);
+    cmd.AddValue ("accessRate", "Access link data rate (raise it with multi-gigabit bottlenecks)", accessRate);
+    cmd.AddValue ("mtu", "Link MTU in bytes (e.g. 9000 for jumbo frames)", mtu_bytes);
+    cmd.AddValue ("aggregation", "Send this many segments as one packet (GSO/TSO-like) to cut per-packet events", aggregation);
     cmd.AddValue ("errorRate", "Bottleneck link error rate", errorRate);
     cmd.AddValue ("nFlows", "Number of flows (must be even)", nFlows);
     cmd.AddValue ("transport_prot", "Transport protocol (e.g., TcpCubic, TcpNewReno)", transport_prot);
     cmd.AddValue ("run", "Run index for RNG stream", run);
+    cmd.AddValue ("crn", "Pin the stack and error-model RNG streams (common random numbers)", crn);
+    cmd.AddValue ("compare", "Also run this TCP variant on the same random streams and report paired differences", compare_prot);
     cmd.AddValue ("tracing", "Flag to enable/disable tracing", tracing);
+    cmd.AddValue ("traceMode", "CWND tracer: buffered or text (per-event flush, for comparison)", traceMode);
+    cmd.AddValue ("traceFormat", "Buffered CWND trace format: text (one .data file per flow) or binary (one <prefix>-cwnd.bin)", traceFormat);
+    cmd.AddValue ("traceBucket", "Aggregate the text CWND trace into buckets of this many simulated seconds (min, max, mean, last, count); 0 writes every update", traceBucket);
+    cmd.AddValue ("probe", "Write <prefix>-flow<i>-probe.data rows of cwnd, ssthresh, RTT, RTO, bytes in flight and congestion state", probe);
+    cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or priorityqueue", scheduler);
+    cmd.AddValue ("profile", "Report event count, events/s, simulated s per wall s, peak RSS and time spent in our callbacks", profile);
     cmd.AddValue ("prefix_name", "Prefix of output trace file", prefix_file_name);
     cmd.AddValue ("duration", "Simulation duration in seconds", duration);
+    cmd.AddValue ("queueDisc", "Bottleneck queue discipline: default, none, pfifo, red, codel, fqcodel or pie", queueDisc);
+    cmd.AddValue ("queueSize", "Bottleneck queue discipline limit (e.g. 100p, 150000B)", queueSize);
+    cmd.AddValue ("queueStats", "Report bottleneck sojourn-time and queue-length percentiles (implied by queueDisc)", queueTelemetry);
+    cmd.AddValue ("sampleInterval", "Per-flow goodput sampling interval in seconds; 0 disables", sampleInterval);
+    cmd.AddValue ("fairnessWindow", "Sliding window in seconds for the per-window Jain index and dest1/dest2 share ratios (advanced every quarter window); 0 disables", fairnessWindow);
+    cmd.AddValue ("warmup", "Seconds after the sources start excluded from steady-state goodput", warmup);
+    cmd.AddValue ("steadyTolerance", "Stop once every flow's goodput per sampleInterval window stays within this fraction of its mean over steadyWindows consecutive windows; 0 disables", steadyTolerance);
+    cmd.AddValue ("steadyWindows", "Consecutive windows required by steadyTolerance (at least 2)", steadyWindows);
+    cmd.AddValue ("replications", "Build once and fork this many runs (run, run+1, ...); 0 disables", replications);
+    cmd.AddValue ("jobs", "Maximum concurrent replication children", jobs);
+    cmd.AddValue ("ciWidth", "Keep forking runs until every 95% CI half width is below this fraction of its mean; 0 disables", ciWidth);
+    cmd.AddValue ("minRuns", "Minimum runs before the ciWidth stopping rule applies", minRuns);
+    cmd.AddValue ("maxRuns", "Upper bound on runs with ciWidth", maxRuns);
+    cmd.AddValue ("mpi", "Run senders and receivers on two MPI ranks split at the bottleneck (mpirun -np 2)", mpi);
+    cmd.AddValue ("cacheDir", "Reuse results of identical runs stored in this directory (safe to share between parallel runs); empty disables. Runs writing trace, probe or goodput files and profile runs bypass it; timings are never cached", cacheDir);
     cmd.Parse (argc, argv);
 
+    NS_ABORT_MSG_UNLESS (traceMode == "buffered" || traceMode == "text",
+                         "Unknown traceMode " << traceMode);
+    NS_ABORT_MSG_UNLESS (traceFormat == "text" || traceFormat == "binary",
+                         "Unknown traceFormat " << traceFormat);
+    NS_ABORT_MSG_IF (traceFormat == "binary" && traceMode == "text",
+                     "traceFormat=binary requires traceMode=buffered");
+    NS_ABORT_MSG_IF (traceBucket > 0 && (traceMode == "text" || traceFormat == "binary"),
+                     "traceBucket requires traceMode=buffered and traceFormat=text");
+    NS_ABORT_MSG_IF (queueTelemetry && queueDisc == "none",
+                     "queueStats needs a queue disc on the bottleneck, which queueDisc=none removes");
+    cwndBucket = Seconds (traceBucket);
+    profiling = profile;
+    NS_ABORT_MSG_IF (mpi && (replications > 0 || ciWidth > 0 || !compare_prot.empty () || steadyTolerance > 0),
+                     "mpi supports a single run without compare, replications or steadyTolerance");
+    // --mpi: senders (nodes 0, 1) on rank 0, receivers (nodes 2, 3, 4) on rank 1.
+    uint32_t systemId = mpi ? EnableDistributed (&argc, &argv) : 0;
+    bool senderRank = !mpi || systemId == 0;
+    bool receiverRank = !mpi || systemId == 1;
+    SetScheduler (scheduler);
+    NS_ABORT_MSG_IF (profile && (replications > 0 || ciWidth > 0 || !compare_prot.empty ()),
+                     "profile only applies to a single run");
+
+    NS_ABORT_MSG_IF (tracing && (replications > 0 || ciWidth > 0), "tracing is not supported with replications");
+    NS_ABORT_MSG_IF (ciWidth > 0 && minRuns < 2, "minRuns must be at least 2");
+    NS_ABORT_MSG_IF (jobs == 0, "jobs must be at least 1");
+    NS_ABORT_MSG_IF (tracing && !compare_prot.empty (), "tracing is not supported with compare");
+    NS_ABORT_MSG_IF (tracing && traceFormat == "text" && nFlows > kMaxTraceFiles,
+                     "tracing writes one file per flow; use --traceFormat=binary above " << kMaxTraceFiles << " flows");
+    NS_ABORT_MSG_IF (probe && nFlows > kMaxTraceFiles,
+                     "probe writes one file per flow and is limited to " << kMaxTraceFiles << " flows");
+    NS_ABORT_MSG_IF (probe && !compare_prot.empty (), "probe is not supported with compare");
+    NS_ABORT_MSG_IF (probe && (replications > 0 || ciWidth > 0), "probe is not supported with replications");
+    NS_ABORT_MSG_IF (sampleInterval > 0 && (replications > 0 || ciWidth > 0 || !compare_prot.empty ()),
+                     "sampleInterval is not supported with replications");
+    NS_ABORT_MSG_IF (steadyTolerance > 0 && sampleInterval <= 0, "steadyTolerance requires sampleInterval");
+    NS_ABORT_MSG_IF (steadyTolerance > 0 && steadyWindows < 2, "steadyWindows must be at least 2");
+    if (!compare_prot.empty () && replications == 0 && ciWidth == 0)
+    {
+        replications = 1;
+    }
+
     if (nFlows % 2 != 0)
     {
         NS_LOG_ERROR ("nFlows must be an even number!");
         return 1;
     }
+    NS_ABORT_MSG_IF (nFlows == 0, "nFlows must be at least 2");
+    traceFlushBytes = std::max (kTraceMinFlushBytes, kTraceChunkBytes / nFlows);
 
     SeedManager::SetRun (run);
+    // Trace, probe and goodput files are not stored, so runs producing them
+    // always simulate; so do --profile runs, which measure this process.
+    bool cacheable = !cacheDir.empty () && !tracing && !probe && !profile && sampleInterval <= 0 && !mpi;
+    if (cacheable && LookupCachedResult (cacheDir, ResultCacheKey (kResultCacheVersion, argc, argv, "tcp=" + transport_prot)))
+    {
+        return 0;
+    }
 
     transport_prot = std::string ("ns3::") + transport_prot;
     TypeId tcpTid;
@@ -104,17 +403,29 @@ main (int argc, char *argv[])
                          "TypeId " << transport_prot << " not found");
     Config::SetDefault ("ns3::TcpL4Protocol::SocketType", TypeIdValue (tcpTid));
 
-    Header *temp_header = new Ipv4Header ();
-    uint32_t ip_header = temp_header->GetSerializedSize ();
-    delete temp_header;
-    temp_header = new TcpHeader ();
-    uint32_t tcp_header = temp_header->GetSerializedSize ();
-    delete temp_header;
-    uint32_t tcp_adu_size = mtu_bytes - (ip_header + tcp_header);
+    TypeId compareTid;
+    if (!compare_prot.empty ())
+    {
+        compare_prot = std::string ("ns3::") + compare_prot;
+        NS_ABORT_MSG_UNLESS (TypeId::LookupByNameFailSafe (compare_prot, &compareTid),
+                             "TypeId " << compare_prot << " not found");
+    }
+
+    SegmentSizing sizing = SizeSegments (mtu_bytes, aggregation);
+    uint32_t tcp_adu_size = sizing.aduSize;
+    uint32_t link_mtu = sizing.linkMtu;
 
     NS_LOG_INFO ("Create nodes.");
     NodeContainer nodes;
-    nodes.Create (5);
+    if (mpi)
+    {
+        nodes.Create (2, 0);
+        nodes.Create (3, 1);
+    }
+    else
+    {
+        nodes.Create (5);
+    }
     NodeContainer n0n1 = NodeContainer (nodes.Get (0), nodes.Get (1));
     NodeContainer n1n2 = NodeContainer (nodes.Get (1), nodes.Get (2));
     NodeContainer n2n3 = NodeContainer (nodes.Get (2), nodes.Get (3));
@@ -122,22 +433,43 @@ main (int argc, char *argv[])
 
     NS_LOG_INFO ("Create channels.");
     PointToPointHelper p2pAccess;
-    p2pAccess.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
+    p2pAccess.SetDeviceAttribute ("DataRate", StringValue (accessRate));
+    p2pAccess.SetDeviceAttribute ("Mtu", UintegerValue (link_mtu));
     p2pAccess.SetChannelAttribute ("Delay", StringValue ("0.01ms"));
 
     PointToPointHelper p2pBottleneck;
     p2pBottleneck.SetDeviceAttribute ("DataRate", StringValue (dataRate));
+    p2pBottleneck.SetDeviceAttribute ("Mtu", UintegerValue (link_mtu));
     p2pBottleneck.SetChannelAttribute ("Delay", StringValue (delay));
+    if (queueDisc != "default")
+    {
+        // Keep the device queue minimal so packets wait in the queue disc.
+        p2pBottleneck.SetQueue ("ns3::DropTailQueue", "MaxSize", StringValue ("1p"));
+    }
+    // RateErrorModel counts errors per byte by default, so larger (jumbo or
+    // aggregated) packets are dropped more often, like a corrupted frame.
+    // Data (received by node 2) and ACKs (received by node 1) share one
+    // model, whose draws interleave both directions. The two ranks of --mpi
+    // cannot reproduce that sequence, so there the ACKs get their own model
+    // and stream, and drop other packets than a sequential run would.
     Ptr<RateErrorModel> em = CreateObject<RateErrorModel> ();
     em->SetAttribute ("ErrorRate", DoubleValue (errorRate));
-    p2pBottleneck.SetDeviceAttribute ("ReceiveErrorModel", PointerValue (em));
+    Ptr<RateErrorModel> emAck = em;
+    if (mpi)
+    {
+        emAck = CreateObject<RateErrorModel> ();
+        emAck->SetAttribute ("ErrorRate", DoubleValue (errorRate));
+    }
 
     PointToPointHelper p2pDest2;
-    p2pDest2.SetDeviceAttribute ("DataRate", StringValue ("100Mbps"));
+    p2pDest2.SetDeviceAttribute ("DataRate", StringValue (accessRate));
+    p2pDest2.SetDeviceAttribute ("Mtu", UintegerValue (link_mtu));
     p2pDest2.SetChannelAttribute ("Delay", StringValue ("50ms"));
 
     NetDeviceContainer d0d1 = p2pAccess.Install (n0n1);
     NetDeviceContainer d1d2 = p2pBottleneck.Install (n1n2);
+    d1d2.Get (1)->SetAttribute ("ReceiveErrorModel", PointerValue (em));
+    d1d2.Get (0)->SetAttribute ("ReceiveErrorModel", PointerValue (emAck));
     NetDeviceContainer d2d3 = p2pAccess.Install (n2n3);
     NetDeviceContainer d2d4 = p2pDest2.Install (n2n4);
 
@@ -145,6 +477,16 @@ main (int argc, char *argv[])
     InternetStackHelper stack;
     stack.Install (nodes);
 
+    if (crn)
+    {
+        stack.AssignStreams (nodes, kStackStream);
+        em->AssignStreams (kErrorModelStream);
+        if (emAck != em)
+        {
+            emAck->AssignStreams (kErrorModelStream + 1);
+        }
+    }
+
     NS_LOG_INFO ("Assign IP Addresses.");
     Ipv4AddressHelper ipv4;
     ipv4.SetBase ("10.1.1.0", "255.255.255.0");
@@ -159,6 +501,9 @@ main (int argc, char *argv[])
     ipv4.SetBase ("10.1.4.0", "255.255.255.0");
     Ipv4InterfaceContainer i2i4 = ipv4.Assign (d2d4);
 
+    NS_LOG_INFO ("Set up the " << queueDisc << " bottleneck queue disc.");
+    Ptr<QueueDisc> bottleneckQueue = SetupBottleneckQueue (queueDisc, queueSize, queueTelemetry, d1d2);
+
     NS_LOG_INFO ("Enable static global routing.");
     Ipv4GlobalRoutingHelper::PopulateRoutingTables ();
 
@@ -173,6 +518,8 @@ main (int argc, char *argv[])
 
     ApplicationContainer sinkAppsDest1;
     ApplicationContainer sinkAppsDest2;
+    ApplicationContainer sourceApps;
+    ApplicationContainer allSinks;
 
     for (uint32_t i = 0; i < nFlows; ++i)
     {
@@ -190,19 +537,23 @@ main (int argc, char *argv[])
             destAddress = dest2Address;
         }
 
-        Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), port + i));
-        PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", sinkLocalAddress);
-        ApplicationContainer sinkApp = sinkHelper.Install (sinkNode);
-        sinkApp.Start (Seconds (sinkStartTime));
-        sinkApp.Stop (Seconds (simStopTime));
-
-        if (sinkNode == nodes.Get (3))
-        {
-            sinkAppsDest1.Add (sinkApp);
-        }
-        else
+        if (receiverRank)
         {
-            sinkAppsDest2.Add (sinkApp);
+            Address sinkLocalAddress (InetSocketAddress (Ipv4Address::GetAny (), port + i));
+            PacketSinkHelper sinkHelper ("ns3::TcpSocketFactory", sinkLocalAddress);
+            ApplicationContainer sinkApp = sinkHelper.Install (sinkNode);
+            sinkApp.Start (Seconds (sinkStartTime));
+            sinkApp.Stop (Seconds (simStopTime));
+            allSinks.Add (sinkApp);
+
+            if (sinkNode == nodes.Get (3))
+            {
+                sinkAppsDest1.Add (sinkApp);
+            }
+            else
+            {
+                sinkAppsDest2.Add (sinkApp);
+            }
         }
 
         Address remoteAddress (InetSocketAddress (destAddress, port + i));
@@ -212,49 +563,202 @@ main (int argc, char *argv[])
         sourceHelper.SetAttribute ("Remote", AddressValue (remoteAddress));
         sourceHelper.SetAttribute ("SendSize", UintegerValue (tcp_adu_size));
         sourceHelper.SetAttribute ("MaxBytes", UintegerValue (data_mbytes));
+        if (!senderRank)
+        {
+            continue;
+        }
 
         ApplicationContainer sourceApp = sourceHelper.Install (nodes.Get (0));
         sourceApp.Start (Seconds (sourceStartTime));
         sourceApp.Stop (Seconds (simStopTime));
+        sourceApps.Add (sourceApp);
     }
 
-    if (tracing)
+    if (tracing && senderRank)
     {
         NS_LOG_INFO ("Enable CWND Tracing.");
-        for (uint32_t i = 0; i < nFlows; ++i)
+        EnableCwndTracing (prefix_file_name, traceMode, traceFormat, nFlows, nodes.Get (0)->GetId (), sourceApps,
+                           sourceStartTime);
+    }
+
+    if (probe && senderRank)
+    {
+        NS_LOG_INFO ("Enable socket probes.");
+        EnableSocketProbes (prefix_file_name, nFlows, sourceApps, sourceStartTime);
+    }
+
+    if (fairnessWindow > 0 && receiverRank)
+    {
+        NS_LOG_INFO ("Enable sliding-window fairness.");
+        EnableFairnessWindows (nFlows, SinkRxBytes (allSinks), &DestShareRatio, fairnessWindow,
+                               sourceStartTime + warmup);
+    }
+
+    double activeTime = simStopTime - sourceStartTime;
+
+    if (replications > 0 || ciWidth > 0)
+    {
+        bool adaptive = ciWidth > 0;
+        bool paired = !compare_prot.empty ();
+        uint32_t targetRuns = adaptive ? std::max (maxRuns, minRuns) : replications;
+        NS_LOG_INFO ("Run forked replications (up to " << targetRuns << ").");
+        auto simulate = [&] (ReplicationTask task) {
+            SeedManager::SetRun (task.run);
+            stack.AssignStreams (nodes, kStackStream);
+            em->AssignStreams (kErrorModelStream);
+            SetTcpSocketType (nodes, task.variant == 0 ? tcpTid : compareTid);
+            Simulator::Stop (Seconds (simStopTime));
+            Simulator::Run ();
+            return ReplicationResult {task.run, task.variant, AverageGoodput (sinkAppsDest1, activeTime),
+                                      AverageGoodput (sinkAppsDest2, activeTime),
+                                      SummarizeFairness (FlowGoodput (allSinks, activeTime))};
+        };
+
+        ReplicationStats dest1;
+        ReplicationStats dest2;
+        ReplicationStats ratio;
+        ReplicationStats diff1;
+        ReplicationStats diff2;
+        uint32_t done = 0;
+        bool converged = false;
+        std::cout << std::endl
+                  << "------ Lab 2 Part 2 Replications (" << transport_prot << ", from Run " << run << ") ------"
+                  << std::endl;
+        while (done < targetRuns && !converged)
+        {
+            // Adaptive runs start with minRuns, then add only as many as the
+            // current half-widths predict are missing (at most jobs), so a
+            // point that is nearly converged does not pay for a full batch.
+            uint32_t batch = targetRuns;
+            if (adaptive && done < minRuns)
+            {
+                batch = minRuns - done;
+            }
+            else if (adaptive)
+            {
+                uint32_t needed = std::max ({dest1.RunsFor (ciWidth), dest2.RunsFor (ciWidth), ratio.RunsFor (ciWidth)});
+                batch = std::min (jobs, std::max (needed, done + 1) - done);
+            }
+            batch = std::min (batch, targetRuns - done);
+            std::vector<ReplicationTask> tasks;
+            for (uint32_t r = run + done; r < run + done + batch; ++r)
+            {
+                tasks.push_back ({r, 0});
+                if (paired)
+                {
+                    tasks.push_back ({r, 1});
+                }
+            }
+            std::vector<ReplicationResult> results = ForkReplications (tasks, jobs, simulate);
+            for (std::size_t k = 0; k < results.size (); ++k)
+            {
+                const ReplicationResult &r = results[k];
+                PrintParseMe (r.variant == 0 ? transport_prot : compare_prot, nFlows, r.run, r.goodputDest1,
+                              r.goodputDest2, r.fairness);
+                if (r.variant != 0)
+                {
+                    diff1.Add (results[k - 1].goodputDest1 - r.goodputDest1);
+                    diff2.Add (results[k - 1].goodputDest2 - r.goodputDest2);
+                    continue;
+                }
+                dest1.Add (r.goodputDest1);
+                dest2.Add (r.goodputDest2);
+                if (r.goodputDest2 > 0)
+                {
+                    ratio.Add (r.goodputDest1 / r.goodputDest2);
+                }
+            }
+            done += batch;
+            // The ratio only counts runs where dest2 received data, so a
+            // starved dest2 keeps it from converging.
+            converged = adaptive && done >= minRuns && dest1.Converged (ciWidth, minRuns) &&
+                        dest2.Converged (ciWidth, minRuns) && ratio.Converged (ciWidth, minRuns);
+        }
+
+        std::cout << "Flows to dest1 (Short RTT): " << sinkAppsDest1.GetN () << ", Avg Goodput: " << dest1.Mean ()
+                  << " +/- " << dest1.HalfWidth95 () << " bps (95% CI, " << dest1.n << " runs)" << std::endl;
+        std::cout << "Flows to dest2 (Long RTT): " << sinkAppsDest2.GetN () << ", Avg Goodput: " << dest2.Mean ()
+                  << " +/- " << dest2.HalfWidth95 () << " bps (95% CI, " << dest2.n << " runs)" << std::endl;
+        // Below two runs with dest2 data the ratio has no confidence interval
+        bool ratioDefined = ratio.n >= 2;
+        if (ratioDefined)
         {
-            std::string flowString = "-flow" + std::to_string (i);
-            std::string traceFile = prefix_file_name + flowString + "-cwnd.data";
-            Simulator::Schedule (Seconds (sourceStartTime + 0.00001),
-                                 &TraceCwnd,
-                                 traceFile,
-                                 nodes.Get (0)->GetId(),
-                                 i);
+            std::cout << "Goodput ratio dest1/dest2: " << ratio.Mean () << " +/- " << ratio.HalfWidth95 ()
+                      << " (95% CI, " << ratio.n << " runs)" << std::endl;
         }
+        else
+        {
+            std::cout << "Goodput ratio dest1/dest2: undefined (dest2 received data in " << ratio.n << " of "
+                      << dest2.n << " runs)" << std::endl;
+        }
+        if (adaptive)
+        {
+            std::cout << (converged ? "Converged" : "Not converged") << " to relative CI width " << ciWidth
+                      << " after " << done << " runs" << std::endl;
+            std::cout << "PARSE_CI," << transport_prot << "," << nFlows << "," << done << ","
+                      << dest1.Mean () << "," << dest1.HalfWidth95 () << ","
+                      << dest2.Mean () << "," << dest2.HalfWidth95 () << ","
+                      << (ratioDefined ? ratio.Mean () : std::numeric_limits<double>::quiet_NaN ()) << ","
+                      << (ratioDefined ? ratio.HalfWidth95 () : std::numeric_limits<double>::quiet_NaN ()) << ","
+                      << converged << std::endl;
+        }
+        if (paired)
+        {
+            std::cout << "Paired diff vs " << compare_prot << " (common random numbers):" << std::endl;
+            std::cout << "  dest1: " << diff1.Mean () << " +/- " << diff1.HalfWidth95 () << " bps"
+                      << (std::fabs (diff1.Mean ()) > diff1.HalfWidth95 () ? " (significant)" : "") << std::endl;
+            std::cout << "  dest2: " << diff2.Mean () << " +/- " << diff2.HalfWidth95 () << " bps"
+                      << (std::fabs (diff2.Mean ()) > diff2.HalfWidth95 () ? " (significant)" : "") << std::endl;
+            std::cout << "PARSE_PAIRED," << transport_prot << "," << nFlows << "," << diff1.n << "," << compare_prot << ","
+                      << diff1.Mean () << "," << diff1.HalfWidth95 () << ","
+                      << diff2.Mean () << "," << diff2.HalfWidth95 () << std::endl;
+        }
+        std::cout << "----------------------------------------------------" << std::endl;
+
+        StoreCachedResult ();
+        Simulator::Destroy ();
+        return 0;
+    }
+
+    if (sampleInterval > 0 && receiverRank)
+    {
+        NS_LOG_INFO ("Enable goodput sampling.");
+        EnableGoodputSampling (nFlows, SinkRxBytes (allSinks), sampleInterval, sourceStartTime, simStopTime,
+                               sourceStartTime + warmup, steadyTolerance, steadyWindows);
     }
 
     NS_LOG_INFO ("Run Simulation.");
     Simulator::Stop (Seconds (simStopTime));
+    auto wallStart = std::chrono::steady_clock::now ();
     Simulator::Run ();
+    double wallSeconds = std::chrono::duration<double> (std::chrono::steady_clock::now () - wallStart).count ();
     NS_LOG_INFO ("Simulation Done.");
-
-    double activeTime = simStopTime - sourceStartTime;
-    uint64_t totalRxDest1 = 0;
-    uint64_t totalRxDest2 = 0;
-
-    for (uint32_t i = 0; i < sinkAppsDest1.GetN (); ++i)
+    if (!receiverRank)
     {
-        Ptr<PacketSink> sink = DynamicCast<PacketSink> (sinkAppsDest1.Get (i));
-        totalRxDest1 += sink->GetTotalRx ();
+        // Sender rank of an --mpi run; goodput is reported by the receiver rank.
+        std::cout << "Rank " << systemId << " (senders): " << Simulator::GetEventCount () << " events, run "
+                  << wallSeconds << " s wall-clock" << std::endl;
+        if (bottleneckQueue)
+        {
+            PrintQueueTelemetry (queueDisc, bottleneckQueue,
+                                 transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run));
+        }
+        if (tracing)
+        {
+            PrintCwndTraceStats (traceMode, traceFormat, wallSeconds);
+        }
+        Simulator::Destroy ();
+        DisableDistributed ();
+        return 0;
     }
-    double avgGoodputDest1 = (totalRxDest1 * 8.0) / (sinkAppsDest1.GetN () * activeTime);
-
-    for (uint32_t i = 0; i < sinkAppsDest2.GetN (); ++i)
+    if (sampleInterval > 0)
     {
-        Ptr<PacketSink> sink = DynamicCast<PacketSink> (sinkAppsDest2.Get (i));
-        totalRxDest2 += sink->GetTotalRx ();
+        RecordGoodputSample ();
     }
-    double avgGoodputDest2 = (totalRxDest2 * 8.0) / (sinkAppsDest2.GetN () * activeTime);
+
+    activeTime = Simulator::Now ().GetSeconds () - sourceStartTime;
+    double avgGoodputDest1 = AverageGoodput (sinkAppsDest1, activeTime);
+    double avgGoodputDest2 = AverageGoodput (sinkAppsDest2, activeTime);
 
 
     std::cout << std::endl
@@ -262,11 +766,83 @@ main (int argc, char *argv[])
               << std::endl;
     std::cout << "Flows to dest1 (Short RTT): " << sinkAppsDest1.GetN () << ", Avg Goodput: " << avgGoodputDest1 << " bps" << std::endl;
     std::cout << "Flows to dest2 (Long RTT): " << sinkAppsDest2.GetN () << ", Avg Goodput: " << avgGoodputDest2 << " bps" << std::endl;
+    std::vector<double> flowGoodput = FlowGoodput (allSinks, activeTime);
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        uint64_t bytesReceived = DynamicCast<PacketSink> (allSinks.Get (i))->GetTotalRx ();
+        std::cout << "Flow " << i << (i < nFlows / 2 ? " (N0->N3): " : " (N0->N4): ") << bytesReceived
+                  << " bytes received, Goodput: " << flowGoodput[i] << " bps" << std::endl;
+    }
+    FairnessSummary fair = SummarizeFairness (flowGoodput);
+    std::cout << "Jain fairness index: " << fair.jain << " (dest1 " << fair.jainDest1 << ", dest2 "
+              << fair.jainDest2 << ")" << std::endl;
+    if (fair.windows > 0)
+    {
+        std::cout << "Sliding " << fairnessWindow << " s windows (" << fair.windows << "): Jain min "
+                  << fair.windowJainMin << ", mean " << fair.WindowJainMean () << "; dest1/dest2 share min "
+                  << (fair.shares > 0 ? fair.shareMin : 0.0) << ", mean " << fair.ShareMean () << ", max "
+                  << fair.shareMax << std::endl;
+    }
+    if (bottleneckQueue && senderRank)
+    {
+        PrintQueueTelemetry (queueDisc, bottleneckQueue,
+                             transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run));
+    }
+    if (sampler.stoppedEarly)
+    {
+        std::cout << "Stopped early at " << Simulator::Now ().GetSeconds () << " s (steady state within "
+                  << steadyTolerance << " for " << steadyWindows << " samples)" << std::endl;
+    }
     
-    std::cout << "PARSE_ME," << transport_prot << "," << nFlows << "," << run << "," << avgGoodputDest1 << "," << avgGoodputDest2 << std::endl;
+    PrintParseMe (transport_prot, nFlows, run, avgGoodputDest1, avgGoodputDest2, fair);
+
+    if (sampleInterval > 0)
+    {
+        WriteGoodputSeries (prefix_file_name + "-goodput.data");
+        std::vector<double> steady = SteadyStateGoodput (sourceStartTime + warmup);
+        if (steady.empty ())
+        {
+            std::cout << "Steady-state goodput: not enough samples after the warm-up" << std::endl;
+        }
+        else
+        {
+            double steadyDest1 = 0.0;
+            double steadyDest2 = 0.0;
+            std::cout << "Steady-state goodput (after " << warmup << " s warm-up, "
+                      << sampleInterval << " s samples):" << std::endl;
+            for (uint32_t i = 0; i < nFlows; ++i)
+            {
+                (i < nFlows / 2 ? steadyDest1 : steadyDest2) += steady[i];
+                std::cout << "Steady Flow " << i << ": " << steady[i] << " bps" << std::endl;
+            }
+            std::cout << "Steady dest1 (Short RTT) Avg Goodput: " << steadyDest1 / (nFlows / 2) << " bps" << std::endl;
+            std::cout << "Steady dest2 (Long RTT) Avg Goodput: " << steadyDest2 / (nFlows / 2) << " bps" << std::endl;
+        }
+    }
     
+    if (mpi)
+    {
+        std::cout << "Rank " << systemId << " (receivers): run " << wallSeconds << " s wall-clock on 2 MPI ranks"
+                  << std::endl;
+    }
+    PrintSchedulerStats (scheduler, transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run),
+                         wallSeconds);
+    if (tracing && senderRank)
+    {
+        PrintCwndTraceStats (traceMode, traceFormat, wallSeconds);
+    }
+    if (probe && senderRank)
+    {
+        PrintProbeStats (wallSeconds);
+    }
+    if (profile)
+    {
+        PrintProfile (transport_prot + "," + std::to_string (nFlows) + "," + std::to_string (run), wallSeconds);
+    }
     std::cout << "----------------------------------------------------" << std::endl;
 
+    StoreCachedResult ();
     Simulator::Destroy ();
+    DisableDistributed ();
     return 0;
 }
\ No newline at end of file
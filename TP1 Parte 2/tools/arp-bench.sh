@@ -0,0 +1,47 @@
+#!/bin/sh
+# Lab1_part2 ARP benchmark: event count, wall-clock and first echo RTT vs
+# nCsma, with dynamic ARP and with --staticArp, one process at a time.
+#
+#   g++ -O2 -std=c++17 -pthread -o tools/sweep-runner tools/sweep-runner.cc
+#   tools/arp-bench.sh ~/ns-3.36.1/build [results-dir] [nCsma list]
+#
+# The programs are run as scratch/ns3.$NS3_VERSION-<name>-default, with
+# NS3_VERSION defaulting to 3.36.1, the release the labs target.
+#
+# --staticArp needs NeighborCacheHelper from ns-3.37 or later, so against
+# the default ns-3.36.1 build only dynamic ARP is measured. Point it at a
+# newer build with e.g. NS3_VERSION=3.37 tools/arp-bench.sh ~/ns-3.37/build.
+
+set -e
+
+BUILD=${1:?usage: $0 <ns-3 build dir> [results-dir] [nCsma list]}
+OUT=${2:-arp-bench}
+CSMA=${3:-10,100,250,1000}
+RUNNER=$(dirname "$0")/sweep-runner
+NS3_VERSION=${NS3_VERSION:-3.36.1}
+case $NS3_VERSION in
+    3.[0-9] | 3.[0-9].* | 3.[12][0-9] | 3.[12][0-9].* | 3.3[0-6] | 3.3[0-6].*) ARP=0 ;;
+    *) ARP=0,1 ;;
+esac
+
+mkdir -p "$OUT"
+"$RUNNER" --program="$BUILD/scratch/ns3.$NS3_VERSION-Lab1_part2-default" --jobs=1 \
+    --grid=staticArp=$ARP --grid=nCsma=$CSMA \
+    --out="$OUT/arp.csv" > /dev/null 2> "$OUT/arp.log"
+
+printf "%-10s %8s %12s %10s %14s\n" arp nCsma events "wall s" "first RTT ms"
+awk -F, '
+    NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+    $col["metric"] == "arp_events" || $col["metric"] == "arp_run_seconds" || $col["metric"] == "first_rtt_ms" {
+        key = ($col["staticArp"] == 1 ? "static" : "dynamic") " " $col["nCsma"]
+        value[key, $col["metric"]] = $col["value"]
+        keys[key] = 1
+    }
+    END {
+        for (k in keys)
+        {
+            split (k, f, " ")
+            printf "%-10s %8d %12d %10.3f %14.3f\n", f[1], f[2],
+                   value[k, "arp_events"], value[k, "arp_run_seconds"], value[k, "first_rtt_ms"]
+        }
+    }' "$OUT/arp.csv" | sort -k1,1 -k2,2n
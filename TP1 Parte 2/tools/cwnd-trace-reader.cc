@@ -0,0 +1,222 @@
+// Reader for the binary CWND traces written by lab2-part1 / lab2-part2 with
+// --tracing=1 --traceFormat=binary. Build it standalone:
+//
+//   g++ -O2 -std=c++17 -o cwnd-trace-reader cwnd-trace-reader.cc
+//
+// With only a file it prints a per-flow summary; --export writes the
+// "time cwnd" text files the plotting scripts already read, named like the
+// text tracer's output (<prefix>-flow<i>-cwnd.data):
+//
+//   ./cwnd-trace-reader part1a-cubic-cwnd.bin
+//   ./cwnd-trace-reader part1a-cubic-cwnd.bin --export=part1a-cubic --flow=0
+
+#include <iostream>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <limits>
+#include <cstdio>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+static const uint32_t kBinaryTraceVersion = 1;
+static const std::size_t kHeaderBytes = 16;
+static const std::size_t kChunkHeaderBytes = 8;
+
+struct FlowSummary
+{
+    uint64_t records = 0;
+    int64_t firstNs = 0;
+    int64_t lastNs = 0;
+    uint32_t minCwnd = std::numeric_limits<uint32_t>::max ();
+    uint32_t maxCwnd = 0;
+};
+
+// Calls visit (timeNs, flow, cwnd) for every record, chunk by chunk, straight
+// out of the mapping. Returns false if the file is truncated or malformed.
+template <typename Visitor>
+static bool
+ForEachRecord (const unsigned char *data, std::size_t size, Visitor visit)
+{
+    std::size_t offset = kHeaderBytes;
+    while (offset < size)
+    {
+        if (size - offset < kChunkHeaderBytes)
+        {
+            return false;
+        }
+        uint32_t count;
+        std::memcpy (&count, data + offset, sizeof (count));
+        offset += kChunkHeaderBytes;
+        if ((size - offset) / 16 < count)
+        {
+            return false;
+        }
+        const int64_t *times = reinterpret_cast<const int64_t *> (data + offset);
+        const uint32_t *flows = reinterpret_cast<const uint32_t *> (data + offset + 8 * std::size_t (count));
+        const uint32_t *values = flows + count;
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            visit (times[i], flows[i], values[i]);
+        }
+        offset += 16 * std::size_t (count);
+    }
+    return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+    std::string path;
+    std::string exportPrefix;
+    long onlyFlow = -1;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare (0, 9, "--export=") == 0)
+        {
+            exportPrefix = arg.substr (9);
+        }
+        else if (arg.compare (0, 7, "--flow=") == 0)
+        {
+            onlyFlow = std::strtol (arg.c_str () + 7, nullptr, 10);
+        }
+        else if (path.empty () && arg.compare (0, 2, "--") != 0)
+        {
+            path = arg;
+        }
+        else
+        {
+            std::cerr << "Unknown argument " << arg << std::endl;
+            return 1;
+        }
+    }
+    if (path.empty ())
+    {
+        std::cerr << "Usage: " << argv[0] << " <trace.bin> [--export=<prefix>] [--flow=<i>]" << std::endl;
+        return 1;
+    }
+
+    int fd = open (path.c_str (), O_RDONLY);
+    struct stat st;
+    if (fd < 0 || fstat (fd, &st) != 0)
+    {
+        std::perror (path.c_str ());
+        return 1;
+    }
+    std::size_t size = st.st_size;
+    if (size < kHeaderBytes)
+    {
+        std::cerr << path << ": not a CWND trace" << std::endl;
+        return 1;
+    }
+    void *mapping = mmap (nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close (fd);
+    if (mapping == MAP_FAILED)
+    {
+        std::perror ("mmap");
+        return 1;
+    }
+    madvise (mapping, size, MADV_SEQUENTIAL);
+    const unsigned char *data = static_cast<const unsigned char *> (mapping);
+
+    uint32_t header[3];
+    std::memcpy (header, data + 4, sizeof (header));
+    if (std::memcmp (data, "CWND", 4) != 0 || header[0] != kBinaryTraceVersion)
+    {
+        std::cerr << path << ": not a version " << kBinaryTraceVersion << " CWND trace" << std::endl;
+        return 1;
+    }
+    uint32_t nFlows = header[1];
+    if (onlyFlow >= static_cast<long> (nFlows))
+    {
+        std::cerr << "Trace has only " << nFlows << " flows" << std::endl;
+        return 1;
+    }
+
+    bool ok;
+    if (!exportPrefix.empty ())
+    {
+        // Same line format as the buffered text tracer, so exported files
+        // match what --traceFormat=text would have written.
+        std::vector<std::FILE *> files (nFlows, nullptr);
+        for (uint32_t f = 0; f < nFlows; ++f)
+        {
+            if (onlyFlow >= 0 && f != onlyFlow)
+            {
+                continue;
+            }
+            std::string name = exportPrefix + "-flow" + std::to_string (f) + "-cwnd.data";
+            files[f] = std::fopen (name.c_str (), "w");
+            if (files[f] == nullptr)
+            {
+                std::perror (name.c_str ());
+                return 1;
+            }
+            std::setvbuf (files[f], nullptr, _IOFBF, 1 << 20);
+        }
+        ok = ForEachRecord (data, size, [&] (int64_t timeNs, uint32_t flow, uint32_t cwnd) {
+            if (flow < nFlows && files[flow] != nullptr)
+            {
+                if (timeNs == 0)
+                {
+                    std::fprintf (files[flow], "0.0 %u\n", cwnd);
+                }
+                else
+                {
+                    std::fprintf (files[flow], "%g %u\n", timeNs * 1e-9, cwnd);
+                }
+            }
+        });
+        for (std::FILE *file : files)
+        {
+            if (file != nullptr)
+            {
+                std::fclose (file);
+            }
+        }
+    }
+    else
+    {
+        std::vector<FlowSummary> flows (nFlows);
+        ok = ForEachRecord (data, size, [&] (int64_t timeNs, uint32_t flow, uint32_t cwnd) {
+            if (flow >= nFlows)
+            {
+                return;
+            }
+            FlowSummary &s = flows[flow];
+            if (s.records++ == 0)
+            {
+                s.firstNs = timeNs;
+            }
+            s.lastNs = timeNs;
+            s.minCwnd = std::min (s.minCwnd, cwnd);
+            s.maxCwnd = std::max (s.maxCwnd, cwnd);
+        });
+        for (uint32_t f = 0; f < nFlows; ++f)
+        {
+            if ((onlyFlow >= 0 && f != onlyFlow) || flows[f].records == 0)
+            {
+                continue;
+            }
+            const FlowSummary &s = flows[f];
+            std::cout << "Flow " << f << ": " << s.records << " records, " << s.firstNs * 1e-9 << " s to "
+                      << s.lastNs * 1e-9 << " s, cwnd " << s.minCwnd << " to " << s.maxCwnd << " bytes"
+                      << std::endl;
+        }
+    }
+    munmap (mapping, size);
+
+    if (!ok)
+    {
+        std::cerr << path << ": truncated trace (was the simulation interrupted?)" << std::endl;
+        return 1;
+    }
+    return 0;
+}
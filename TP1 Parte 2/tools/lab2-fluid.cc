@@ -0,0 +1,471 @@
+// Fluid-model goodput estimator for the lab2 dumbbell (part1) and the
+// two-RTT topology (part2). It takes the same --name=value options as the
+// packet-level programs, ignores the ones it does not model (so a sweep grid
+// can be pointed at either binary), and prints the same per-flow / PARSE_ME
+// lines in a few milliseconds. Build it standalone:
+//
+//   g++ -O2 -std=c++17 -o lab2-fluid lab2-fluid.cc
+//
+// Pre-screen a large grid with it through sweep-runner, then run only the
+// interesting points at packet level:
+//
+//   ./sweep-runner --program=./lab2-fluid --grid=delay=5ms,20ms,80ms
+//       --grid=errorRate=0.000001,0.00001,0.0001 --out=fluid.csv
+//
+// --validate=<packet-sweep.csv> re-estimates every point of a sweep-runner
+// CSV produced by lab2-part1 or lab2-part2 (runs of the same point are
+// averaged) and reports the estimator's error against it.
+//
+// Model: per-flow AIMD windows in segments, dW/dt = increase - (1 - beta) W
+// lambda, where lambda is the loss-event rate from the per-byte error model
+// plus overflow of the bottleneck buffer. The buffer is a fluid queue shared
+// by all flows that also sets the RTT. NewReno adds one segment per RTT.
+// CUBIC adds the average slope of its cubic regrowth, (1 - beta) W / K, but
+// never less than its TCP-friendly rate. Slow start doubles the window per
+// RTT until the first expected loss. Windows are capped by the ns-3 socket
+// buffers. With random loss only, the steady state is W = sqrt (a / ((1 -
+// beta) p)), the mean-field form of the Mathis sqrt (3 / (2 p)) law.
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdlib>
+
+struct Params
+{
+    std::string topology = "part1";
+    double dataRate = 1e6;
+    double delay = 0.020;
+    double errorRate = 0.00001;
+    uint32_t nFlows = 0; // 0: the program's default (1 for part1, 2 for part2)
+    std::string transport_prot = "TcpNewReno";
+    uint32_t run = 0;
+    double duration = 20.0;
+    uint32_t mtu = 1500;
+    uint32_t aggregation = 1;
+    double accessRate = 100e6;
+};
+
+// "1Mbps", "10Gbps", "500kbps", "64000bps" -> bits per second.
+static double
+ParseRate (const std::string &s)
+{
+    std::size_t end = 0;
+    double v = std::stod (s, &end);
+    std::string unit = s.substr (end);
+    if (unit == "Gbps")
+    {
+        return v * 1e9;
+    }
+    if (unit == "Mbps")
+    {
+        return v * 1e6;
+    }
+    if (unit == "Kbps" || unit == "kbps")
+    {
+        return v * 1e3;
+    }
+    return v;
+}
+
+// "20ms", "0.01ms", "100us", "1s" -> seconds.
+static double
+ParseTime (const std::string &s)
+{
+    std::size_t end = 0;
+    double v = std::stod (s, &end);
+    std::string unit = s.substr (end);
+    if (unit == "ms")
+    {
+        return v * 1e-3;
+    }
+    if (unit == "us")
+    {
+        return v * 1e-6;
+    }
+    if (unit == "ns")
+    {
+        return v * 1e-9;
+    }
+    return v;
+}
+
+// Applies one --name=value option; options the model does not use (run
+// counts, tracing, queue stats, ...) are accepted and ignored.
+static void
+SetParam (Params &p, const std::string &name, const std::string &value)
+{
+    if (name == "topology")
+    {
+        p.topology = value;
+    }
+    else if (name == "dataRate")
+    {
+        p.dataRate = ParseRate (value);
+    }
+    else if (name == "delay")
+    {
+        p.delay = ParseTime (value);
+    }
+    else if (name == "errorRate")
+    {
+        p.errorRate = std::stod (value);
+    }
+    else if (name == "nFlows")
+    {
+        p.nFlows = std::stoul (value);
+    }
+    else if (name == "transport_prot")
+    {
+        p.transport_prot = value;
+    }
+    else if (name == "run")
+    {
+        p.run = std::stoul (value);
+    }
+    else if (name == "duration")
+    {
+        p.duration = std::stod (value);
+    }
+    else if (name == "mtu")
+    {
+        p.mtu = std::stoul (value);
+    }
+    else if (name == "aggregation")
+    {
+        p.aggregation = std::max (1ul, std::stoul (value));
+    }
+    else if (name == "accessRate")
+    {
+        p.accessRate = ParseRate (value);
+    }
+}
+
+struct FlowPath
+{
+    double baseRtt;
+    bool dest2;
+};
+
+// Per-flow goodput in bps, measured like the packet programs: bytes
+// delivered over (duration - source start).
+static std::vector<double>
+EstimateGoodput (const Params &p)
+{
+    const double sourceStart = 1.0;
+    const double accessDelay = 0.00001;
+    const double dest2Delay = 0.050;
+    bool part2 = p.topology == "part2";
+    uint32_t nFlows = p.nFlows > 0 ? p.nFlows : (part2 ? 2 : 1);
+
+    // Segments carry mtu - 52 bytes of payload (times the aggregation): IP
+    // and TCP headers plus the 12-byte timestamp option ns-3 enables by
+    // default. Every packet also carries a 2-byte PPP header.
+    double payload = double (p.mtu - 52) * p.aggregation;
+    double wire = payload + 54;
+    double bottleneck = std::min (p.dataRate, p.accessRate);
+    double capacity = bottleneck / (8 * wire); // segments/s
+    double lossProb = 1 - std::pow (1 - p.errorRate, wire);
+
+    bool cubic = p.transport_prot.find ("Cubic") != std::string::npos;
+    double beta = cubic ? 0.7 : 0.5;
+    double cubicC = 0.4;
+    double friendly = cubic ? 3 * (1 - beta) / (1 + beta) : 1.0;
+    double maxWindow = 131072.0 * p.aggregation / payload;
+    double initialWindow = std::max (1u, 10 / p.aggregation);
+    // Device queue of 100 packets plus the default FqCoDel root queue disc,
+    // which holds the standing queue near its 5 ms target.
+    double buffer = 100 + capacity * 0.005;
+
+    std::vector<FlowPath> paths (nFlows);
+    double minRtt = 1e9;
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        bool dest2 = part2 && i >= nFlows / 2;
+        double oneWay = accessDelay + p.delay + (dest2 ? dest2Delay : accessDelay);
+        double serialization = wire * 8 * (2 / p.accessRate + 1 / p.dataRate);
+        paths[i] = {2 * oneWay + serialization, dest2};
+        minRtt = std::min (minRtt, paths[i].baseRtt);
+    }
+
+    std::vector<double> window (nFlows, initialWindow);
+    std::vector<bool> slowStart (nFlows, true);
+    std::vector<double> expectedLosses (nFlows, 0.0);
+    std::vector<double> delivered (nFlows, 0.0);
+    std::vector<double> rate (nFlows, 0.0);
+    double queue = 0;
+    double dt = minRtt / 20;
+    for (double t = sourceStart + minRtt; t < p.duration; t += dt)
+    {
+        double total = 0;
+        for (uint32_t i = 0; i < nFlows; ++i)
+        {
+            rate[i] = window[i] / (paths[i].baseRtt + queue / capacity);
+            total += rate[i];
+        }
+        queue = std::min (buffer, std::max (0.0, queue + (total - capacity) * dt));
+        double overflow = (queue >= buffer && total > capacity) ? (total - capacity) / total : 0.0;
+        double served = std::min (1.0, capacity / std::max (total, 1e-12));
+
+        for (uint32_t i = 0; i < nFlows; ++i)
+        {
+            double rtt = paths[i].baseRtt + queue / capacity;
+            double lossRate = rate[i] * (lossProb + overflow);
+            delivered[i] += rate[i] * served * (1 - lossProb) * dt;
+
+            double increase;
+            if (slowStart[i])
+            {
+                increase = window[i] / rtt;
+                expectedLosses[i] += lossRate * dt;
+                if (expectedLosses[i] >= 1 || window[i] >= maxWindow)
+                {
+                    slowStart[i] = false;
+                    window[i] *= expectedLosses[i] >= 1 ? beta : 1.0;
+                    continue;
+                }
+            }
+            else
+            {
+                increase = friendly / rtt;
+                if (cubic)
+                {
+                    double k = std::cbrt (window[i] * (1 - beta) / cubicC);
+                    increase = std::max (increase, (1 - beta) * window[i] / k);
+                }
+                increase -= (1 - beta) * window[i] * lossRate;
+            }
+            window[i] = std::min (maxWindow, std::max (1.0, window[i] + increase * dt));
+        }
+    }
+
+    std::vector<double> goodput (nFlows);
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        goodput[i] = delivered[i] * payload * 8 / (p.duration - sourceStart);
+    }
+    return goodput;
+}
+
+static void
+PrintEstimate (const Params &p)
+{
+    auto start = std::chrono::steady_clock::now ();
+    std::vector<double> goodput = EstimateGoodput (p);
+    double ms = std::chrono::duration<double, std::milli> (std::chrono::steady_clock::now () - start).count ();
+    bool part2 = p.topology == "part2";
+    std::string prot = "ns3::" + p.transport_prot;
+    uint32_t nFlows = goodput.size ();
+    double activeTime = p.duration - 1.0;
+
+    std::cout << "------ Lab 2 " << (part2 ? "Part 2" : "Part 1") << " Fluid Estimate (" << prot << ") ------"
+              << std::endl;
+    double sum = 0;
+    double dest1 = 0;
+    double dest2 = 0;
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        bool toDest2 = part2 && i >= nFlows / 2;
+        sum += goodput[i];
+        (toDest2 ? dest2 : dest1) += goodput[i];
+        std::cout << "Flow " << i << (toDest2 ? " (N0->N4): " : " (N0->N3): ")
+                  << static_cast<uint64_t> (goodput[i] * activeTime / 8) << " bytes received, Goodput: " << goodput[i]
+                  << " bps" << std::endl;
+    }
+    if (part2)
+    {
+        std::cout << "PARSE_ME," << prot << "," << nFlows << "," << p.run << "," << dest1 / (nFlows / 2) << ","
+                  << dest2 / (nFlows - nFlows / 2) << std::endl;
+    }
+    else
+    {
+        std::cout << "Average Flow Goodput: " << sum / nFlows << " bps" << std::endl;
+    }
+    std::cout << "Fluid estimate in " << ms << " ms" << std::endl;
+    std::cout << "PARSE_FLUID," << prot << "," << nFlows << "," << p.run << "," << ms << std::endl;
+}
+
+struct PacketPoint
+{
+    std::vector<std::pair<std::string, std::string>> axes;
+    std::map<std::string, double> sums;
+    std::map<std::string, uint32_t> counts;
+};
+
+static std::vector<std::string>
+SplitCsv (const std::string &line)
+{
+    std::vector<std::string> fields;
+    std::istringstream in (line);
+    std::string field;
+    while (std::getline (in, field, ','))
+    {
+        fields.push_back (field);
+    }
+    return fields;
+}
+
+// Compares the estimator with a packet-level sweep: avg_goodput for part1,
+// dest1_goodput / dest2_goodput for part2, averaged over the run axis.
+static int
+Validate (const std::string &csvPath, const Params &defaults)
+{
+    std::ifstream in (csvPath);
+    if (!in)
+    {
+        std::cerr << "Cannot open " << csvPath << std::endl;
+        return 1;
+    }
+    std::string line;
+    std::getline (in, line);
+    std::vector<std::string> header = SplitCsv (line);
+    std::size_t metricCol = std::find (header.begin (), header.end (), "metric") - header.begin ();
+    if (metricCol + 2 >= header.size ())
+    {
+        std::cerr << csvPath << ": not a sweep-runner CSV" << std::endl;
+        return 1;
+    }
+
+    // point id -> grouping key (axes without run) -> accumulated metrics
+    std::map<std::string, PacketPoint> points;
+    while (std::getline (in, line))
+    {
+        std::vector<std::string> f = SplitCsv (line);
+        if (f.size () < metricCol + 3)
+        {
+            continue;
+        }
+        const std::string &metric = f[metricCol];
+        if (metric != "avg_goodput" && metric != "dest1_goodput" && metric != "dest2_goodput")
+        {
+            continue;
+        }
+        std::string key;
+        std::vector<std::pair<std::string, std::string>> axes;
+        for (std::size_t c = 1; c < metricCol; ++c)
+        {
+            if (header[c] != "run")
+            {
+                key += header[c] + "=" + f[c] + " ";
+                axes.push_back ({header[c], f[c]});
+            }
+        }
+        PacketPoint &point = points[key];
+        point.axes = axes;
+        point.sums[metric] += std::stod (f[metricCol + 2]);
+        ++point.counts[metric];
+    }
+
+    std::vector<double> errors;
+    for (const auto &entry : points)
+    {
+        const PacketPoint &point = entry.second;
+        Params p = defaults;
+        if (point.sums.count ("dest1_goodput") > 0)
+        {
+            p.topology = "part2";
+        }
+        for (const auto &axis : point.axes)
+        {
+            SetParam (p, axis.first, axis.second);
+        }
+        std::vector<double> goodput = EstimateGoodput (p);
+        uint32_t nFlows = goodput.size ();
+        std::map<std::string, double> fluid;
+        if (p.topology == "part2")
+        {
+            double dest1 = 0;
+            double dest2 = 0;
+            for (uint32_t i = 0; i < nFlows; ++i)
+            {
+                (i < nFlows / 2 ? dest1 : dest2) += goodput[i];
+            }
+            fluid["dest1_goodput"] = dest1 / (nFlows / 2);
+            fluid["dest2_goodput"] = dest2 / (nFlows - nFlows / 2);
+        }
+        else
+        {
+            double sum = 0;
+            for (double g : goodput)
+            {
+                sum += g;
+            }
+            fluid["avg_goodput"] = sum / nFlows;
+        }
+        for (const auto &m : point.sums)
+        {
+            double packet = m.second / point.counts.at (m.first);
+            double estimate = fluid[m.first];
+            double error = packet > 0 ? (estimate - packet) / packet : 0.0;
+            errors.push_back (std::fabs (error));
+            std::cout << entry.first << m.first << ": packet " << packet << " bps, fluid " << estimate << " bps, error "
+                      << 100 * error << "%" << std::endl;
+        }
+    }
+    if (errors.empty ())
+    {
+        std::cerr << csvPath << ": no avg_goodput / dest*_goodput rows" << std::endl;
+        return 1;
+    }
+    std::sort (errors.begin (), errors.end ());
+    double mean = 0;
+    std::size_t within10 = 0;
+    for (double e : errors)
+    {
+        mean += e;
+        within10 += e <= 0.10;
+    }
+    mean /= errors.size ();
+    std::cout << "Fluid vs packet: " << errors.size () << " comparisons, mean |error| " << 100 * mean
+              << "%, median " << 100 * errors[errors.size () / 2] << "%, max " << 100 * errors.back ()
+              << "%, within 10%: " << within10 << "/" << errors.size () << std::endl;
+    std::cout << "PARSE_FLUID_ERROR," << errors.size () << "," << mean << "," << errors[errors.size () / 2] << ","
+              << errors.back () << std::endl;
+    return 0;
+}
+
+int
+main (int argc, char *argv[])
+{
+    Params p;
+    std::string validate;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        std::size_t eq = arg.find ('=');
+        if (arg.compare (0, 2, "--") != 0 || eq == std::string::npos)
+        {
+            std::cerr << "Usage: " << argv[0] << " [--topology=part1|part2] [--<lab2 option>=value ...]"
+                      << " [--validate=<packet-sweep.csv>]" << std::endl;
+            return 1;
+        }
+        std::string name = arg.substr (2, eq - 2);
+        std::string value = arg.substr (eq + 1);
+        if (name == "validate")
+        {
+            validate = value;
+        }
+        else
+        {
+            SetParam (p, name, value);
+        }
+    }
+    if (p.topology != "part1" && p.topology != "part2")
+    {
+        std::cerr << "Unknown topology " << p.topology << std::endl;
+        return 1;
+    }
+    if (!validate.empty ())
+    {
+        return Validate (validate, p);
+    }
+    PrintEstimate (p);
+    return 0;
+}
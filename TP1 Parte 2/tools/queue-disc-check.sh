@@ -0,0 +1,63 @@
+#!/bin/sh
+# Bottleneck queue disc check: runs lab2-part1 and lab2-part2 briefly with
+# every --queueDisc value and fails unless each run exits cleanly and, with
+# --queueStats, reports its PARSE_QUEUE line.
+#
+#   g++ -O2 -std=c++17 -pthread -o tools/sweep-runner tools/sweep-runner.cc
+#   tools/queue-disc-check.sh ~/ns-3.36.1/build [results-dir]
+#
+# The programs are run as scratch/ns3.$NS3_VERSION-<name>-default, with
+# NS3_VERSION defaulting to 3.36.1, the release the labs target.
+
+set -e
+
+BUILD=${1:?usage: $0 <ns-3 build dir> [results-dir]}
+OUT=${2:-queue-disc-check}
+RUNNER=$(dirname "$0")/sweep-runner
+NS3_VERSION=${NS3_VERSION:-3.36.1}
+
+mkdir -p "$OUT"
+status=0
+
+check ()
+{
+    name=$1
+    shift
+    csv="$OUT/$name.csv"
+    "$RUNNER" --program="$BUILD/scratch/ns3.$NS3_VERSION-$1-default" --grid=duration=3 \
+        --grid=queueDisc=default,pfifo,red,codel,fqcodel,pie --grid=queueStats=1 \
+        --out="$csv" > /dev/null 2> "$OUT/$name.log" || true
+    "$RUNNER" --program="$BUILD/scratch/ns3.$NS3_VERSION-$1-default" --grid=duration=3 \
+        --grid=queueDisc=none --grid=queueStats=0 \
+        --out="$OUT/$name-none.csv" > /dev/null 2>> "$OUT/$name.log" || true
+    tail -n +2 "$OUT/$name-none.csv" >> "$csv"
+    # Every point must exit 0, and every point with queueStats=1 needs a
+    # qdisc_drops row.
+    if ! awk -F, -v name="$name" '
+        NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        {
+            key = $col["queueDisc"]
+            disc[key] = 1
+            if ($col["queueStats"] == 1) want[key] = 1
+            if ($col["metric"] == "exit_status" && $col["value"] != 0) failed[key] = "exit " $col["value"]
+            if ($col["metric"] == "qdisc_drops") queue[key] = 1
+        }
+        END {
+            bad = 0
+            for (k in disc)
+            {
+                if (!(k in failed) && want[k] && !(k in queue)) failed[k] = "no PARSE_QUEUE line"
+                printf "%-12s %-10s %s\n", name, k, (k in failed) ? "FAILED (" failed[k] ")" : "ok"
+                bad += (k in failed)
+            }
+            exit bad > 0
+        }' "$csv" > "$OUT/$name.txt"
+    then
+        status=1
+    fi
+    sort "$OUT/$name.txt"
+}
+
+check part1 lab2-part1
+check part2 lab2-part2
+exit $status
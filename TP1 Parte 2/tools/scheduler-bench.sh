@@ -0,0 +1,54 @@
+#!/bin/sh
+# Event scheduler benchmark: runs every lab scenario at a small and a large
+# size with each --scheduler, one process at a time so the wall-clock numbers
+# are comparable, and prints wall-clock and events/s per point.
+#
+#   g++ -O2 -std=c++17 -pthread -o tools/sweep-runner tools/sweep-runner.cc
+#   tools/scheduler-bench.sh ~/ns-3.36.1/build [results-dir]
+#
+# The programs are run as scratch/ns3.$NS3_VERSION-<name>-default, with
+# NS3_VERSION defaulting to 3.36.1, the release the labs target.
+#
+# The per-scenario CSVs (sweep-runner's long format) and progress logs are
+# kept in results-dir.
+
+set -e
+
+BUILD=${1:?usage: $0 <ns-3 build dir> [results-dir]}
+OUT=${2:-scheduler-bench}
+RUNNER=$(dirname "$0")/sweep-runner
+NS3_VERSION=${NS3_VERSION:-3.36.1}
+SCHEDULERS=map,heap,list,calendar,priorityqueue
+
+mkdir -p "$OUT"
+
+bench ()
+{
+    name=$1
+    shift
+    "$RUNNER" --program="$BUILD/scratch/ns3.$NS3_VERSION-$name-default" --jobs=1 \
+        --grid=scheduler=$SCHEDULERS "$@" --out="$OUT/$name.csv" > /dev/null 2> "$OUT/$name.log"
+}
+
+bench Lab1_part1 --grid=nClients=1,5
+bench Lab1_part2 --grid=verbose=0 --grid=nCsma=1,100
+bench Lab1_part3 --grid=verbose=0 --grid=nWifi=1,9
+bench lab2-part1 --grid=nFlows=4,2000 --grid=duration=20
+bench lab2-part2 --grid=nFlows=4,200 --grid=duration=20
+
+for csv in "$OUT"/*.csv
+do
+    awk -F, -v scenario="$(basename "$csv" .csv)" '
+        NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+        $col["metric"] == "sched_run_seconds" || $col["metric"] == "sched_events_per_second" {
+            key = ""
+            for (i = 2; i < col["metric"]; i++) key = key " " $i
+            value[key, $col["metric"]] = $col["value"]
+            keys[key] = 1
+        }
+        END {
+            for (k in keys)
+                printf "%-12s%-40s %10.3f s %14.0f events/s\n", scenario, k,
+                       value[k, "sched_run_seconds"], value[k, "sched_events_per_second"]
+        }' "$csv" | sort
+done
@@ -0,0 +1,43 @@
+#!/bin/sh
+# Lab1_part1 large-star benchmark: setup time, run time and peak RSS vs
+# nClients for each --routing mode, one process at a time.
+#
+#   g++ -O2 -std=c++17 -pthread -o tools/sweep-runner tools/sweep-runner.cc
+#   tools/star-scale-bench.sh ~/ns-3.36.1/build [results-dir] [nClients list]
+#
+# The programs are run as scratch/ns3.$NS3_VERSION-<name>-default, with
+# NS3_VERSION defaulting to 3.36.1, the release the labs target.
+#
+# Global routing's all-pairs computation dominates setup well before 10k
+# clients; drop it from ROUTINGS to explore larger stars.
+
+set -e
+
+BUILD=${1:?usage: $0 <ns-3 build dir> [results-dir] [nClients list]}
+OUT=${2:-star-scale-bench}
+CLIENTS=${3:-10,100,1000,10000}
+ROUTINGS=${ROUTINGS:-global,static,nix}
+RUNNER=$(dirname "$0")/sweep-runner
+NS3_VERSION=${NS3_VERSION:-3.36.1}
+
+mkdir -p "$OUT"
+"$RUNNER" --program="$BUILD/scratch/ns3.$NS3_VERSION-Lab1_part1-default" --jobs=1 \
+    --grid=largeStar=1 --grid=routing=$ROUTINGS --grid=nClients=$CLIENTS \
+    --out="$OUT/star-scale.csv" > /dev/null 2> "$OUT/star-scale.log"
+
+printf "%-8s %10s %10s %10s %12s\n" routing nClients "setup s" "run s" "peak RSS kB"
+awk -F, '
+    NR == 1 { for (i = 1; i <= NF; i++) col[$i] = i; next }
+    $col["metric"] == "setup_seconds" || $col["metric"] == "run_seconds" || $col["metric"] == "peak_rss_kb" {
+        key = $col["routing"] " " $col["nClients"]
+        value[key, $col["metric"]] = $col["value"]
+        keys[key] = 1
+    }
+    END {
+        for (k in keys)
+        {
+            split (k, f, " ")
+            printf "%-8s %10d %10.3f %10.3f %12d\n", f[1], f[2],
+                   value[k, "setup_seconds"], value[k, "run_seconds"], value[k, "peak_rss_kb"]
+        }
+    }' "$OUT/star-scale.csv" | sort -k1,1 -k2,2n
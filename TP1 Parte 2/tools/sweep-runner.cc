@@ -0,0 +1,467 @@
+// Parallel parameter sweep driver for lab2-part1 / lab2-part2.
+//
+// Runs the cartesian product of the given grid concurrently on a bounded
+// pool of workers and merges every run's summary into one long-format CSV
+// (one row per point, metric and flow). Rows from a tagged summary line also
+// carry its <prot>,<size>,<run> prefix in the tag_prot, tag_size and tag_run
+// columns, which tell apart the runs and variants of one invocation (e.g.
+// --replications or --compare). Build it standalone:
+//
+//   g++ -O2 -std=c++17 -pthread -o sweep-runner sweep-runner.cc
+//
+// and point it at the built scratch binary (not "./ns3 run", which would
+// re-check the build from every worker), named after the ns-3 release (the
+// labs target 3.36.1; Lab1_part2's --staticArp needs 3.37 or later), e.g.
+//
+//   ./sweep-runner --program=build/scratch/ns3.36.1-lab2-part2-default
+//       --grid=transport_prot=TcpNewReno,TcpCubic --grid=nFlows=2,4,8
+//       --grid=run=0:19 --out=part2-sweep.csv
+//
+// The lab2-part1 scaling benchmark (wall-clock and peak RSS vs nFlows, from
+// the PARSE_SCALE line) is the same driver with one worker per point:
+//
+//   ./sweep-runner --program=build/scratch/ns3.36.1-lab2-part1-default --jobs=1
+//       --grid=nFlows=10,100,1000,10000 --grid=flowsPerSink=1,1000 --out=scale.csv
+//
+// Flow completion times (PARSE_FCT, one row per flow size bucket) vs load:
+//
+//   ./sweep-runner --program=build/scratch/ns3.36.1-lab2-part1-default
+//       --grid=workload=fct --grid=flowArrivalRate=50,100,200 --grid=run=0:9 --out=fct.csv
+//
+// A one-value axis passes a fixed option to every run. With a shared result
+// cache, regenerating a CSV only simulates the points that changed:
+//
+//   ./sweep-runner --program=build/scratch/ns3.36.1-lab2-part2-default
+//       --grid=cacheDir=lab2-cache --grid=nFlows=2,4,8 --grid=run=0:19 --out=part2-sweep.csv
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+struct GridAxis
+{
+    std::string name;
+    std::vector<std::string> values;
+};
+
+struct Record
+{
+    std::string metric;
+    std::string flow;
+    std::string value;
+    // <prot>,<size>,<run> of the tagged line the record came from, if any.
+    std::string prot;
+    std::string size;
+    std::string run;
+};
+
+static std::vector<std::string>
+Split (const std::string &s, char sep)
+{
+    std::vector<std::string> out;
+    std::stringstream ss (s);
+    std::string item;
+    while (std::getline (ss, item, sep))
+    {
+        out.push_back (item);
+    }
+    return out;
+}
+
+// "run=0:9" expands to 0..9, anything else is a comma-separated list.
+static GridAxis
+ParseAxis (const std::string &spec)
+{
+    std::size_t eq = spec.find ('=');
+    if (eq == std::string::npos || eq == 0)
+    {
+        std::cerr << "Bad grid axis '" << spec << "', expected name=v1,v2,..." << std::endl;
+        std::exit (1);
+    }
+    GridAxis axis;
+    axis.name = spec.substr (0, eq);
+    std::string values = spec.substr (eq + 1);
+    std::size_t colon = values.find (':');
+    if (colon != std::string::npos && values.find (',') == std::string::npos)
+    {
+        long first = std::stol (values.substr (0, colon));
+        long last = std::stol (values.substr (colon + 1));
+        for (long v = first; v <= last; ++v)
+        {
+            axis.values.push_back (std::to_string (v));
+        }
+    }
+    else
+    {
+        axis.values = Split (values, ',');
+    }
+    return axis;
+}
+
+static std::vector<std::vector<std::string>>
+ExpandGrid (const std::vector<GridAxis> &axes)
+{
+    std::vector<std::vector<std::string>> points (1);
+    for (const GridAxis &axis : axes)
+    {
+        std::vector<std::vector<std::string>> next;
+        for (const std::vector<std::string> &p : points)
+        {
+            for (const std::string &v : axis.values)
+            {
+                next.push_back (p);
+                next.back ().push_back (v);
+            }
+        }
+        points.swap (next);
+    }
+    return points;
+}
+
+// Runs the program with the given arguments and returns its stdout. Other
+// workers fork concurrently, so the pipe is close-on-exec (their children
+// must not hold our write end open) and the child only calls
+// async-signal-safe functions before execv.
+static int
+RunProgram (const std::vector<std::string> &argv, std::string &output)
+{
+    std::vector<char *> args;
+    for (const std::string &a : argv)
+    {
+        args.push_back (const_cast<char *> (a.c_str ()));
+    }
+    args.push_back (nullptr);
+    int fds[2];
+    if (pipe2 (fds, O_CLOEXEC) != 0)
+    {
+        return -1;
+    }
+    pid_t pid = fork ();
+    if (pid < 0)
+    {
+        close (fds[0]);
+        close (fds[1]);
+        return -1;
+    }
+    if (pid == 0)
+    {
+        dup2 (fds[1], STDOUT_FILENO);
+        close (fds[0]);
+        close (fds[1]);
+        execv (args[0], args.data ());
+        _exit (127);
+    }
+    close (fds[1]);
+    char buf[4096];
+    ssize_t n;
+    while ((n = read (fds[0], buf, sizeof (buf))) > 0)
+    {
+        output.append (buf, n);
+    }
+    close (fds[0]);
+    int status = 0;
+    waitpid (pid, &status, 0);
+    return WIFEXITED (status) ? WEXITSTATUS (status) : 128 + WTERMSIG (status);
+}
+
+// Positional names of the fields after "<TAG>,<prot>,<nFlows>,<run>," in
+// the machine-readable summary lines.
+struct TaggedLine
+{
+    const char *tag;
+    std::vector<std::string> names;
+    // The first value names a row (e.g. a flow size bucket) and goes into
+    // the flow column instead of being a metric.
+    bool keyed = false;
+    // When nonzero, only lines with exactly this many values match, for tags
+    // whose layout differs between lab2-part1 and lab2-part2.
+    std::size_t values = 0;
+};
+
+static const std::vector<TaggedLine> taggedLines = {
+    {"PARSE_ME,", {"avg_goodput", "jain", "fair_windows", "window_jain_min", "window_jain_mean",
+                   "best_share_mean", "best_share_max"}, false, 7},
+    {"PARSE_ME,", {"dest1_goodput", "dest2_goodput", "jain", "jain_dest1", "jain_dest2", "fair_windows",
+                   "window_jain_min", "window_jain_mean", "share_min", "share_mean", "share_max"}},
+    {"PARSE_CI,", {"dest1_mean", "dest1_ci95", "dest2_mean", "dest2_ci95", "ratio_mean", "ratio_ci95",
+                   "converged"}},
+    // The run's own avg_goodput already comes from its PARSE_ME line.
+    {"PARSE_DIFF,", {"compare_prot", "", "compare_avg_goodput", "avg_goodput_diff"}},
+    {"PARSE_SCALE,", {"sinks", "setup_seconds", "run_seconds", "peak_rss_kb"}},
+    {"PARSE_QUEUE,", {"sojourn_p50_ms", "sojourn_p90_ms", "sojourn_p99_ms", "sojourn_p999_ms", "sojourn_max_ms",
+                      "qlen_mean", "qlen_p99", "qlen_max", "qdisc_drops"}},
+    {"PARSE_PAIRED,", {"compare_prot", "dest1_diff_mean", "dest1_diff_ci95", "dest2_diff_mean",
+                       "dest2_diff_ci95"}},
+    {"PARSE_FCT,", {"fct_count", "fct_p50_ms", "fct_p99_ms", "fct_p999_ms"}, true},
+    {"PARSE_FCT_FLOWS,", {"fct_completed", "fct_failed", "fct_peak_concurrent"}},
+    {"PARSE_PROFILE,", {"events", "run_seconds", "events_per_second", "sim_per_wall", "peak_rss_kb"}},
+    {"PARSE_PROFILE_CB,", {"callback_calls", "callback_seconds"}, true},
+    {"PARSE_SCHED,", {"scheduler", "sched_events", "sched_run_seconds", "sched_events_per_second"}},
+    {"PARSE_FLUID,", {"fluid_ms"}},
+    {"PARSE_RTT,", {"rtt_count", "rtt_p50_ms", "rtt_p90_ms", "rtt_p99_ms", "rtt_max_ms"}, true},
+    {"PARSE_LOAD,", {"load_pps", "offered_mbps", "echo_mbps", "echo_loss", "load_rtt_p50_ms", "load_rtt_p90_ms",
+                     "load_rtt_p99_ms", "load_rtt_max_ms"}, true},
+    {"PARSE_KNEE,", {"saturated", "knee_step", "knee_pps", "knee_offered_mbps"}},
+    {"PARSE_ARP,", {"static_arp", "arp_events", "arp_run_seconds", "first_rtt_ms"}},
+    {"PARSE_FLOW,", {"flow_tx_packets", "flow_rx_packets", "flow_loss", "flow_delay_ms", "flow_jitter_ms",
+                     "flow_throughput_kbps"}, true},
+};
+
+// Extracts the tagged summary lines and the per-flow goodput lines from a
+// run's stdout. The "Average Flow Goodput:" line is only used by builds of
+// lab2-part1 that predate its PARSE_ME line, so avg_goodput is never counted
+// twice.
+static std::vector<Record>
+ParseOutput (const std::string &output)
+{
+    std::vector<Record> records;
+    bool sawParseMe = false;
+    std::string legacyAvgGoodput;
+    std::istringstream in (output);
+    std::string line;
+    while (std::getline (in, line))
+    {
+        std::vector<std::string> fields = Split (line, ',');
+        const TaggedLine *tagged = nullptr;
+        for (const TaggedLine &t : taggedLines)
+        {
+            if (line.compare (0, std::strlen (t.tag), t.tag) == 0 &&
+                (t.values == 0 || fields.size () == t.values + 4))
+            {
+                tagged = &t;
+                break;
+            }
+        }
+        if (tagged != nullptr)
+        {
+            sawParseMe = sawParseMe || std::strcmp (tagged->tag, "PARSE_ME,") == 0;
+            // <TAG>,<prot>,<nFlows>,<run>,<values...>; for PARSE_CI and
+            // PARSE_PAIRED the third field is the number of runs used, so
+            // their rows have no tag_run.
+            bool aggregate = std::strcmp (tagged->tag, "PARSE_CI,") == 0 ||
+                             std::strcmp (tagged->tag, "PARSE_PAIRED,") == 0;
+            std::string prot = fields.size () > 1 ? fields[1] : "";
+            std::string size = fields.size () > 2 ? fields[2] : "";
+            std::string run = fields.size () > 3 && !aggregate ? fields[3] : "";
+            if (aggregate && fields.size () > 3)
+            {
+                records.push_back ({"runs_used", "", fields[3], prot, size, run});
+            }
+            std::size_t first = tagged->keyed ? 5 : 4;
+            std::string key = tagged->keyed && fields.size () > 4 ? fields[4] : "";
+            for (std::size_t i = first; i < fields.size (); ++i)
+            {
+                std::size_t k = i - first;
+                std::string name = k < tagged->names.size () ? tagged->names[k] : "field" + std::to_string (i);
+                if (!name.empty ())
+                {
+                    records.push_back ({name, key, fields[i], prot, size, run});
+                }
+            }
+        }
+        else if (line.compare (0, 5, "Flow ") == 0)
+        {
+            // Flow <i> (N0->N3): <bytes> bytes received, Goodput: <bps> bps
+            unsigned flow = 0;
+            unsigned long long bytes = 0;
+            double goodput = 0;
+            if (std::sscanf (line.c_str (), "Flow %u (%*[^)]): %llu bytes received, Goodput: %lf",
+                             &flow, &bytes, &goodput) == 3)
+            {
+                std::ostringstream g;
+                g << goodput;
+                records.push_back ({"rx_bytes", std::to_string (flow), std::to_string (bytes)});
+                records.push_back ({"goodput", std::to_string (flow), g.str ()});
+            }
+        }
+        else if (line.compare (0, 12, "Steady Flow ") == 0)
+        {
+            // Steady Flow <i>: <bps> bps
+            unsigned flow = 0;
+            double goodput = 0;
+            if (std::sscanf (line.c_str (), "Steady Flow %u: %lf", &flow, &goodput) == 2)
+            {
+                std::ostringstream g;
+                g << goodput;
+                records.push_back ({"steady_goodput", std::to_string (flow), g.str ()});
+            }
+        }
+        else if (line.compare (0, 17, "Stopped early at ") == 0)
+        {
+            std::istringstream v (line.substr (17));
+            std::string value;
+            v >> value;
+            records.push_back ({"stopped_at", "", value});
+        }
+        else if (line.compare (0, 22, "Average Flow Goodput: ") == 0)
+        {
+            std::istringstream v (line.substr (22));
+            v >> legacyAvgGoodput;
+        }
+    }
+    if (!sawParseMe && !legacyAvgGoodput.empty ())
+    {
+        records.push_back ({"avg_goodput", "", legacyAvgGoodput});
+    }
+    return records;
+}
+
+static void
+Usage ()
+{
+    std::cerr << "Usage: sweep-runner --program=<binary> --grid=name=v1,v2,... [--grid=...]\n"
+              << "                    [--jobs=N] [--out=sweep.csv] [--dry-run]\n"
+              << "  name=a:b expands to the integers a..b (e.g. --grid=run=0:19)\n"
+              << "  every grid axis is passed to the program as --name=value" << std::endl;
+}
+
+int
+main (int argc, char *argv[])
+{
+    std::string program;
+    std::string outFile = "sweep.csv";
+    unsigned jobs = std::thread::hardware_concurrency ();
+    bool dryRun = false;
+    std::vector<GridAxis> axes;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.compare (0, 10, "--program=") == 0)
+        {
+            program = arg.substr (10);
+        }
+        else if (arg.compare (0, 7, "--grid=") == 0)
+        {
+            axes.push_back (ParseAxis (arg.substr (7)));
+        }
+        else if (arg.compare (0, 7, "--jobs=") == 0)
+        {
+            jobs = std::stoul (arg.substr (7));
+        }
+        else if (arg.compare (0, 6, "--out=") == 0)
+        {
+            outFile = arg.substr (6);
+        }
+        else if (arg == "--dry-run")
+        {
+            dryRun = true;
+        }
+        else
+        {
+            Usage ();
+            return 1;
+        }
+    }
+    if (program.empty ())
+    {
+        Usage ();
+        return 1;
+    }
+    jobs = jobs == 0 ? 1 : jobs;
+
+    std::vector<std::vector<std::string>> points = ExpandGrid (axes);
+    std::vector<std::vector<std::string>> commands;
+    for (const std::vector<std::string> &p : points)
+    {
+        std::vector<std::string> command {program};
+        for (std::size_t a = 0; a < axes.size (); ++a)
+        {
+            command.push_back ("--" + axes[a].name + "=" + p[a]);
+        }
+        commands.push_back (command);
+    }
+
+    if (dryRun)
+    {
+        for (const std::vector<std::string> &command : commands)
+        {
+            for (const std::string &a : command)
+            {
+                std::cout << a << " ";
+            }
+            std::cout << std::endl;
+        }
+        return 0;
+    }
+
+    std::ofstream csv (outFile);
+    if (!csv)
+    {
+        std::cerr << "Cannot open " << outFile << std::endl;
+        return 1;
+    }
+    csv << "point";
+    for (const GridAxis &axis : axes)
+    {
+        csv << "," << axis.name;
+    }
+    csv << ",metric,flow,value,tag_prot,tag_size,tag_run" << std::endl;
+
+    std::mutex outMutex;
+    std::atomic<std::size_t> next (0);
+    std::atomic<std::size_t> done (0);
+    std::atomic<std::size_t> failed (0);
+    auto sweepStart = std::chrono::steady_clock::now ();
+
+    auto worker = [&] () {
+        for (std::size_t idx = next++; idx < commands.size (); idx = next++)
+        {
+            std::string output;
+            auto start = std::chrono::steady_clock::now ();
+            int status = RunProgram (commands[idx], output);
+            double wall = std::chrono::duration<double> (std::chrono::steady_clock::now () - start).count ();
+
+            std::vector<Record> records = ParseOutput (output);
+            records.push_back ({"wall_seconds", "", std::to_string (wall)});
+            records.push_back ({"exit_status", "", std::to_string (status)});
+
+            std::ostringstream rows;
+            for (const Record &r : records)
+            {
+                rows << idx;
+                for (const std::string &v : points[idx])
+                {
+                    rows << "," << v;
+                }
+                rows << "," << r.metric << "," << r.flow << "," << r.value << "," << r.prot << "," << r.size << ","
+                     << r.run << "\n";
+            }
+
+            std::lock_guard<std::mutex> lock (outMutex);
+            csv << rows.str () << std::flush;
+            failed += status != 0;
+            std::cerr << "[" << ++done << "/" << commands.size () << "] point " << idx
+                      << (status != 0 ? " FAILED (exit " + std::to_string (status) + ")" : "")
+                      << " " << wall << " s" << std::endl;
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned j = 0; j < std::min<std::size_t> (jobs, commands.size ()); ++j)
+    {
+        pool.emplace_back (worker);
+    }
+    for (std::thread &t : pool)
+    {
+        t.join ();
+    }
+
+    double sweepWall = std::chrono::duration<double> (std::chrono::steady_clock::now () - sweepStart).count ();
+    std::cerr << commands.size () << " points (" << failed << " failed) on " << jobs << " workers in "
+              << sweepWall << " s, results in " << outFile << std::endl;
+    return failed == 0 ? 0 : 2;
+}
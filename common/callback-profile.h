@@ -0,0 +1,93 @@
+// --profile support shared by the lab2 programs: wall-clock spent in their
+// own callbacks, measured only when enabled, and the PARSE_PROFILE report.
+// Copy it into scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_CALLBACK_PROFILE_H
+#define LAB_CALLBACK_PROFILE_H
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+#include <sys/resource.h>
+
+#include "ns3/core-module.h"
+
+// Callbacks a program does not have are never entered and not reported.
+enum ProfiledCallback
+{
+    kProfileCwndTracer,
+    kProfileSinkRx,
+    kProfileSampler,
+    kProfileProbe,
+    kProfileFct,
+    kProfileFairness,
+    kProfileCount
+};
+
+struct CallbackProfile
+{
+    const char *name;
+    uint64_t calls = 0;
+    std::chrono::steady_clock::duration total {};
+};
+
+inline bool profiling = false;
+inline CallbackProfile callbackProfile[kProfileCount] = {
+    {"cwnd_tracer"}, {"sink_rx"}, {"goodput_sampler"}, {"socket_probe"}, {"fct_workload"}, {"fairness_windows"}};
+
+class ProfileScope
+{
+  public:
+    explicit ProfileScope (ProfiledCallback id)
+        : m_id (id)
+    {
+        if (profiling)
+        {
+            m_start = std::chrono::steady_clock::now ();
+        }
+    }
+
+    ~ProfileScope ()
+    {
+        if (profiling)
+        {
+            CallbackProfile &p = callbackProfile[m_id];
+            ++p.calls;
+            p.total += std::chrono::steady_clock::now () - m_start;
+        }
+    }
+
+  private:
+    ProfiledCallback m_id;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+inline void
+PrintProfile (std::string tag, double wallSeconds)
+{
+    struct rusage usage;
+    getrusage (RUSAGE_SELF, &usage);
+    uint64_t events = ns3::Simulator::GetEventCount ();
+    double simSeconds = ns3::Simulator::Now ().GetSeconds ();
+    std::cout << "Profile: " << events << " events in " << wallSeconds << " s wall-clock, "
+              << events / wallSeconds << " events/s, " << simSeconds / wallSeconds
+              << " simulated s per wall s, peak RSS " << usage.ru_maxrss << " kB" << std::endl;
+    std::cout << "PARSE_PROFILE," << tag << "," << events << "," << wallSeconds << "," << events / wallSeconds
+              << "," << simSeconds / wallSeconds << "," << usage.ru_maxrss << std::endl;
+    for (const CallbackProfile &p : callbackProfile)
+    {
+        if (p.calls == 0)
+        {
+            continue;
+        }
+        double seconds = std::chrono::duration<double> (p.total).count ();
+        std::cout << "  " << p.name << ": " << p.calls << " calls, " << seconds << " s ("
+                  << 100 * seconds / wallSeconds << "% of run), " << seconds / p.calls * 1e9 << " ns/call"
+                  << std::endl;
+        std::cout << "PARSE_PROFILE_CB," << tag << "," << p.name << "," << p.calls << "," << seconds << std::endl;
+    }
+}
+
+#endif // LAB_CALLBACK_PROFILE_H
@@ -0,0 +1,104 @@
+// Scenario setup shared by the lab2 dumbbells: random stream layout, the
+// per-node TCP variant, segment sizing for --mtu/--aggregation and the --mpi
+// split. Copy it into scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_DUMBBELL_SETUP_H
+#define LAB_DUMBBELL_SETUP_H
+
+#include <algorithm>
+#include <cstdint>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#ifdef NS3_MPI
+#include "ns3/mpi-interface.h"
+#endif
+
+const int64_t kStackStream = 0;
+const int64_t kErrorModelStream = 1000;
+
+inline void
+SetTcpSocketType (ns3::NodeContainer nodes, ns3::TypeId tid)
+{
+    for (uint32_t i = 0; i < nodes.GetN (); ++i)
+    {
+        nodes.Get (i)->GetObject<ns3::TcpL4Protocol> ()->SetAttribute ("SocketType", ns3::TypeIdValue (tid));
+    }
+}
+
+struct SegmentSizing
+{
+    // Application bytes per (aggregated) segment.
+    uint32_t aduSize;
+    // Device MTU that carries such a segment unfragmented.
+    uint32_t linkMtu;
+};
+
+// Sizes the segments to fill an mtu-byte packet. Every segment also carries
+// the timestamp option (10 bytes, padded to 12) unless it was disabled, and
+// must still fit the MTU unfragmented.
+//
+// --aggregation: K segments cross every link as one packet, so the events
+// per byte drop K-fold. Bytes and goodput stay exact; cwnd moves in
+// K-segment steps, so its dynamics are only approximate. The initial
+// window and socket buffers (ns-3 defaults 10 segments, 128 KiB) are
+// scaled so they keep roughly the same size in bytes and in segments.
+inline SegmentSizing
+SizeSegments (uint32_t mtu, uint32_t aggregation)
+{
+    uint32_t ipHeader = ns3::Ipv4Header ().GetSerializedSize ();
+    uint32_t tcpHeader = ns3::TcpHeader ().GetSerializedSize ();
+    ns3::TypeId::AttributeInformation timestampInfo;
+    ns3::TypeId::LookupByName ("ns3::TcpSocketBase").LookupAttributeByName ("Timestamp", &timestampInfo);
+    if (ns3::DynamicCast<const ns3::BooleanValue> (timestampInfo.initialValue)->Get ())
+    {
+        tcpHeader += 12;
+    }
+    NS_ABORT_MSG_UNLESS (mtu >= 576 && aggregation >= 1, "mtu must be at least 576 and aggregation at least 1");
+
+    SegmentSizing sizing;
+    sizing.aduSize = (mtu - (ipHeader + tcpHeader)) * aggregation;
+    sizing.linkMtu = sizing.aduSize + ipHeader + tcpHeader;
+    NS_ABORT_MSG_IF (sizing.linkMtu > 65535, "mtu * aggregation must fit in a 65535-byte packet");
+    if (aggregation > 1)
+    {
+        ns3::Config::SetDefault ("ns3::TcpSocket::InitialCwnd",
+                                 ns3::UintegerValue (std::max (1u, 10 / aggregation)));
+        ns3::Config::SetDefault ("ns3::TcpSocket::SndBufSize", ns3::UintegerValue (131072 * aggregation));
+        ns3::Config::SetDefault ("ns3::TcpSocket::RcvBufSize", ns3::UintegerValue (131072 * aggregation));
+    }
+    return sizing;
+}
+
+// --mpi: the dumbbell is split at its bottleneck, senders on rank 0 and
+// receivers on rank 1. The bottleneck becomes a remote point-to-point channel
+// and the distributed simulator takes its delay as the lookahead. Returns
+// this process's rank.
+inline uint32_t
+EnableDistributed (int *argc, char ***argv)
+{
+#ifdef NS3_MPI
+    ns3::GlobalValue::Bind ("SimulatorImplementationType", ns3::StringValue ("ns3::DistributedSimulatorImpl"));
+    ns3::MpiInterface::Enable (argc, argv);
+    NS_ABORT_MSG_UNLESS (ns3::MpiInterface::GetSize () == 2,
+                         "mpi splits the dumbbell in two; run with mpirun -np 2");
+    return ns3::MpiInterface::GetSystemId ();
+#else
+    NS_ABORT_MSG ("mpi requires ns-3 configured with --enable-mpi");
+    return 0;
+#endif
+}
+
+inline void
+DisableDistributed ()
+{
+#ifdef NS3_MPI
+    if (ns3::MpiInterface::IsEnabled ())
+    {
+        ns3::MpiInterface::Disable ();
+    }
+#endif
+}
+
+#endif // LAB_DUMBBELL_SETUP_H
@@ -0,0 +1,110 @@
+// In-memory echo RTT collection shared by the Lab1 programs: per-client and
+// overall RTT percentiles (PARSE_RTT) and an optional per-echo CSV. Copy it
+// into scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_ECHO_RTT_H
+#define LAB_ECHO_RTT_H
+
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+
+#include "log-histogram.h"
+
+// Echo round-trip times collected in memory instead of scraped from the INFO
+// logs: the client's Tx trace stamps each request by packet UID and the echo,
+// which keeps the UID, closes it on Rx.
+struct EchoRttCollector
+{
+    std::unordered_map<uint64_t, ns3::Time> pending;
+    std::vector<LogHistogram> rttUs;
+    std::vector<uint64_t> sent;
+    std::vector<double> firstUs;
+    LogHistogram allUs;
+    std::ofstream csv;
+};
+
+inline EchoRttCollector echoRtt;
+
+inline void
+EchoTx (uint32_t client, ns3::Ptr<const ns3::Packet> packet)
+{
+    echoRtt.pending[packet->GetUid ()] = ns3::Simulator::Now ();
+    ++echoRtt.sent[client];
+}
+
+inline void
+EchoRx (uint32_t client, ns3::Ptr<const ns3::Packet> packet)
+{
+    auto it = echoRtt.pending.find (packet->GetUid ());
+    if (it == echoRtt.pending.end ())
+    {
+        return;
+    }
+    double rttUs = (ns3::Simulator::Now () - it->second).GetNanoSeconds () / 1000.0;
+    if (echoRtt.rttUs[client].total == 0)
+    {
+        echoRtt.firstUs[client] = rttUs;
+    }
+    echoRtt.rttUs[client].Add (rttUs);
+    echoRtt.allUs.Add (rttUs);
+    if (echoRtt.csv.is_open ())
+    {
+        echoRtt.csv << client << "," << it->second.GetSeconds () << "," << rttUs / 1000.0 << "\n";
+    }
+    echoRtt.pending.erase (it);
+}
+
+inline void
+TraceEchoRtt (ns3::ApplicationContainer clients, std::string csvFile)
+{
+    echoRtt.rttUs.resize (clients.GetN ());
+    echoRtt.sent.resize (clients.GetN ());
+    echoRtt.firstUs.resize (clients.GetN (), 0.0);
+    if (!csvFile.empty ())
+    {
+        echoRtt.csv.open (csvFile);
+        NS_ABORT_MSG_UNLESS (echoRtt.csv, "Cannot open " << csvFile);
+        echoRtt.csv << "client,tx_s,rtt_ms\n";
+    }
+    for (uint32_t i = 0; i < clients.GetN (); ++i)
+    {
+        clients.Get (i)->TraceConnectWithoutContext ("Tx", ns3::MakeBoundCallback (&EchoTx, i));
+        clients.Get (i)->TraceConnectWithoutContext ("Rx", ns3::MakeBoundCallback (&EchoRx, i));
+    }
+}
+
+inline void
+PrintRttLine (std::string tag, std::string client, uint64_t sent, const LogHistogram &h)
+{
+    std::cout << "RTT client " << client << ": " << h.total << "/" << sent << " echoed, p50 "
+              << h.Percentile (50) / 1000 << " ms, p90 " << h.Percentile (90) / 1000 << " ms, p99 "
+              << h.Percentile (99) / 1000 << " ms, max " << h.max / 1000 << " ms" << std::endl;
+    std::cout << "PARSE_RTT," << tag << "," << client << "," << h.total << "," << h.Percentile (50) / 1000 << ","
+              << h.Percentile (90) / 1000 << "," << h.Percentile (99) / 1000 << "," << h.max / 1000 << std::endl;
+}
+
+// tag is "<program>,<size>,<run>" as in the other PARSE_ lines
+inline void
+PrintEchoRtt (std::string tag)
+{
+    uint64_t totalSent = 0;
+    for (uint32_t i = 0; i < echoRtt.rttUs.size (); ++i)
+    {
+        PrintRttLine (tag, std::to_string (i), echoRtt.sent[i], echoRtt.rttUs[i]);
+        totalSent += echoRtt.sent[i];
+    }
+    if (echoRtt.rttUs.size () > 1)
+    {
+        PrintRttLine (tag, "all", totalSent, echoRtt.allUs);
+    }
+    echoRtt.csv.close ();
+}
+
+#endif // LAB_ECHO_RTT_H
@@ -0,0 +1,281 @@
+// Periodic per-flow goodput sampling (--sampleInterval, --steadyTolerance)
+// and sliding-window fairness (--fairnessWindow) shared by the lab2
+// programs. Each program supplies the byte counter of flow i, so neither
+// depends on how the other counts received bytes. Copy it into scratch/
+// next to them (see result-cache.h).
+
+#ifndef LAB_FLOW_GOODPUT_H
+#define LAB_FLOW_GOODPUT_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+
+#include "callback-profile.h"
+
+// Received bytes of flow i so far.
+using FlowRxBytes = std::function<uint64_t (std::size_t)>;
+
+struct GoodputSampler
+{
+    std::size_t nFlows = 0;
+    FlowRxBytes rxBytes;
+    ns3::Time interval;
+    std::vector<double> times;
+    std::vector<uint64_t> rx;
+    double steadyFrom = 0.0;
+    double tolerance = 0.0;
+    uint32_t windows = 0;
+    bool stoppedEarly = false;
+};
+
+inline GoodputSampler sampler;
+
+inline void
+RecordGoodputSample ()
+{
+    double now = ns3::Simulator::Now ().GetSeconds ();
+    if (!sampler.times.empty () && sampler.times.back () == now)
+    {
+        return;
+    }
+    sampler.times.push_back (now);
+    for (std::size_t i = 0; i < sampler.nFlows; ++i)
+    {
+        sampler.rx.push_back (sampler.rxBytes (i));
+    }
+}
+
+// Goodput of every flow between the first sample at or after 'from' and the
+// last sample; empty if fewer than two samples fall in that range.
+inline std::vector<double>
+SteadyStateGoodput (double from)
+{
+    std::size_t nFlows = sampler.nFlows;
+    std::size_t first = 0;
+    while (first < sampler.times.size () && sampler.times[first] < from)
+    {
+        ++first;
+    }
+    if (sampler.times.empty () || first + 1 >= sampler.times.size ())
+    {
+        return {};
+    }
+    std::size_t last = sampler.times.size () - 1;
+    std::vector<double> goodput (nFlows);
+    double span = sampler.times[last] - sampler.times[first];
+    for (std::size_t i = 0; i < nFlows; ++i)
+    {
+        goodput[i] = (sampler.rx[last * nFlows + i] - sampler.rx[first * nFlows + i]) * 8.0 / span;
+    }
+    return goodput;
+}
+
+// True once each of the last 'windows' sample intervals lies after the
+// warm-up and, for every flow, the goodput measured in those intervals is
+// nonzero and spreads by at most the relative tolerance around its mean.
+inline bool
+CheckSteadyState ()
+{
+    std::size_t nFlows = sampler.nFlows;
+    std::size_t last = sampler.times.size () - 1;
+    if (sampler.times.size () <= sampler.windows ||
+        sampler.times[last - sampler.windows] < sampler.steadyFrom)
+    {
+        return false;
+    }
+    for (std::size_t i = 0; i < nFlows; ++i)
+    {
+        double min = std::numeric_limits<double>::max ();
+        double max = 0.0;
+        double sum = 0.0;
+        for (std::size_t k = last + 1 - sampler.windows; k <= last; ++k)
+        {
+            double span = sampler.times[k] - sampler.times[k - 1];
+            double goodput = (sampler.rx[k * nFlows + i] - sampler.rx[(k - 1) * nFlows + i]) * 8.0 / span;
+            min = std::min (min, goodput);
+            max = std::max (max, goodput);
+            sum += goodput;
+        }
+        if (min <= 0.0 || max - min > sampler.tolerance * sum / sampler.windows)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+inline void
+SampleGoodput ()
+{
+    ProfileScope scope (kProfileSampler);
+    RecordGoodputSample ();
+    if (sampler.tolerance > 0 && CheckSteadyState ())
+    {
+        sampler.stoppedEarly = true;
+        ns3::Simulator::Stop ();
+        return;
+    }
+    ns3::Simulator::Schedule (sampler.interval, &SampleGoodput);
+}
+
+// Samples the nFlows counters every 'interval' seconds from 'startTime' to
+// 'stopTime'; with a tolerance, stops the simulation once CheckSteadyState ()
+// holds after 'steadyFrom'.
+inline void
+EnableGoodputSampling (std::size_t nFlows, FlowRxBytes rxBytes, double interval, double startTime,
+                       double stopTime, double steadyFrom, double tolerance, uint32_t windows)
+{
+    sampler.nFlows = nFlows;
+    sampler.rxBytes = rxBytes;
+    sampler.interval = ns3::Seconds (interval);
+    sampler.steadyFrom = steadyFrom;
+    sampler.tolerance = tolerance;
+    sampler.windows = windows;
+    std::size_t expected = static_cast<std::size_t> ((stopTime - startTime) / interval) + 2;
+    sampler.times.reserve (expected);
+    sampler.rx.reserve (expected * nFlows);
+    ns3::Simulator::Schedule (ns3::Seconds (startTime), &SampleGoodput);
+}
+
+inline void
+WriteGoodputSeries (std::string fileName)
+{
+    std::ofstream out (fileName);
+    NS_ABORT_MSG_UNLESS (out, "Cannot open " << fileName);
+    std::size_t nFlows = sampler.nFlows;
+    for (std::size_t k = 1; k < sampler.times.size (); ++k)
+    {
+        double span = sampler.times[k] - sampler.times[k - 1];
+        out << sampler.times[k];
+        for (std::size_t i = 0; i < nFlows; ++i)
+        {
+            out << " " << (sampler.rx[k * nFlows + i] - sampler.rx[(k - 1) * nFlows + i]) * 8.0 / span;
+        }
+        out << "\n";
+    }
+}
+
+// Jain's fairness index (sum x)^2 / (n sum x^2) over x[first, last): 1 when
+// every flow gets the same goodput, 1/n when one flow gets everything.
+inline double
+JainIndex (const std::vector<double> &x, std::size_t first, std::size_t last)
+{
+    double sum = 0.0;
+    double sumSq = 0.0;
+    for (std::size_t i = first; i < last; ++i)
+    {
+        sum += x[i];
+        sumSq += x[i] * x[i];
+    }
+    return sumSq > 0 ? sum * sum / ((last - first) * sumSq) : 1.0;
+}
+
+// Jain index of the whole run plus running statistics of the per-window
+// Jain index and share ratio. The per-group indices are only filled in by
+// lab2-part2, whose flows split into two RTT groups.
+struct FairnessSummary
+{
+    double jain = 1.0;
+    double jainDest1 = 1.0;
+    double jainDest2 = 1.0;
+    uint32_t windows = 0;
+    double windowJainMin = 1.0;
+    double windowJainSum = 0.0;
+    uint32_t shares = 0;
+    double shareMin = std::numeric_limits<double>::infinity ();
+    double shareSum = 0.0;
+    double shareMax = 0.0;
+
+    void AddWindow (double windowJain, double share)
+    {
+        ++windows;
+        windowJainMin = std::min (windowJainMin, windowJain);
+        windowJainSum += windowJain;
+        if (std::isfinite (share))
+        {
+            ++shares;
+            shareMin = std::min (shareMin, share);
+            shareSum += share;
+            shareMax = std::max (shareMax, share);
+        }
+    }
+
+    double WindowJainMean () const
+    {
+        return windows > 0 ? windowJainSum / windows : 1.0;
+    }
+
+    double ShareMean () const
+    {
+        return shares > 0 ? shareSum / shares : 0.0;
+    }
+};
+
+// --fairnessWindow: the per-flow byte counters are snapshotted every quarter
+// window into a ring holding one window of history, so every snapshot gives
+// the goodput of each flow over the last full window without keeping a trace.
+// The program's share function turns a window's goodputs into its share
+// ratio; a non-finite ratio skips the window in the share statistics.
+struct FairnessTracker
+{
+    static const uint32_t kSteps = 4;
+    ns3::Time step;
+    std::size_t nFlows = 0;
+    FlowRxBytes rxBytes;
+    std::function<double (const std::vector<double> &)> share;
+    std::vector<uint64_t> ring;
+    uint64_t snapshots = 0;
+    std::vector<double> goodput;
+    FairnessSummary summary;
+};
+
+inline FairnessTracker fairness;
+
+inline void
+SampleFairness ()
+{
+    ProfileScope scope (kProfileFairness);
+    std::size_t n = fairness.nFlows;
+    std::size_t slot = fairness.snapshots % (FairnessTracker::kSteps + 1);
+    for (std::size_t i = 0; i < n; ++i)
+    {
+        fairness.ring[slot * n + i] = fairness.rxBytes (i);
+    }
+    if (fairness.snapshots >= FairnessTracker::kSteps)
+    {
+        std::size_t oldest = (fairness.snapshots - FairnessTracker::kSteps) % (FairnessTracker::kSteps + 1);
+        double span = fairness.step.GetSeconds () * FairnessTracker::kSteps;
+        for (std::size_t i = 0; i < n; ++i)
+        {
+            fairness.goodput[i] = (fairness.ring[slot * n + i] - fairness.ring[oldest * n + i]) * 8.0 / span;
+        }
+        fairness.summary.AddWindow (JainIndex (fairness.goodput, 0, n), fairness.share (fairness.goodput));
+    }
+    ++fairness.snapshots;
+    ns3::Simulator::Schedule (fairness.step, &SampleFairness);
+}
+
+// Starts the windows of 'window' seconds at 'startTime'.
+inline void
+EnableFairnessWindows (std::size_t nFlows, FlowRxBytes rxBytes,
+                       std::function<double (const std::vector<double> &)> share, double window,
+                       double startTime)
+{
+    fairness.step = ns3::Seconds (window / FairnessTracker::kSteps);
+    fairness.nFlows = nFlows;
+    fairness.rxBytes = rxBytes;
+    fairness.share = share;
+    fairness.ring.assign ((FairnessTracker::kSteps + 1) * nFlows, 0);
+    fairness.goodput.assign (nFlows, 0.0);
+    ns3::Simulator::Schedule (ns3::Seconds (startTime), &SampleFairness);
+}
+
+#endif // LAB_FLOW_GOODPUT_H
@@ -0,0 +1,63 @@
+// Log-bucketed histogram shared by the Lab1 and lab2 programs (echo RTTs,
+// bottleneck sojourn times, flow completion times). Copy it into scratch/
+// next to them (see result-cache.h).
+
+#ifndef LAB_LOG_HISTOGRAM_H
+#define LAB_LOG_HISTOGRAM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+// Log-bucketed histogram with 16 sub-buckets per power of two (about 3%
+// relative error), so memory does not grow with the number of samples.
+struct LogHistogram
+{
+    static const uint32_t kSubBuckets = 16;
+    std::vector<uint64_t> counts;
+    uint64_t total = 0;
+    double max = 0.0;
+
+    void Add (double v)
+    {
+        uint32_t b = 0;
+        if (v >= 1.0)
+        {
+            int e;
+            double m = std::frexp (v, &e);
+            b = 1 + (e - 1) * kSubBuckets + static_cast<uint32_t> ((m - 0.5) * 2 * kSubBuckets);
+        }
+        if (b >= counts.size ())
+        {
+            counts.resize (b + 1, 0);
+        }
+        ++counts[b];
+        ++total;
+        max = std::max (max, v);
+    }
+
+    double Percentile (double p) const
+    {
+        uint64_t rank = static_cast<uint64_t> (std::ceil (p / 100.0 * total));
+        uint64_t seen = 0;
+        for (uint32_t b = 0; b < counts.size (); ++b)
+        {
+            seen += counts[b];
+            if (seen >= rank && counts[b] > 0)
+            {
+                if (b == 0)
+                {
+                    return 0.5;
+                }
+                int e = (b - 1) / kSubBuckets + 1;
+                double width = std::ldexp (1.0, e) / (2 * kSubBuckets);
+                double lower = std::ldexp (0.5, e) + ((b - 1) % kSubBuckets) * width;
+                return std::min (lower + width / 2, max);
+            }
+        }
+        return max;
+    }
+};
+
+#endif // LAB_LOG_HISTOGRAM_H
@@ -0,0 +1,165 @@
+// Bottleneck queue disc selection (--queueDisc, --queueSize) and its
+// telemetry (--queueStats) shared by the lab2 programs. Copy it into
+// scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_QUEUE_TELEMETRY_H
+#define LAB_QUEUE_TELEMETRY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/traffic-control-module.h"
+
+#include "log-histogram.h"
+
+struct QueueTelemetry
+{
+    LogHistogram sojournUs;
+    std::vector<double> timeAtLength;
+    uint32_t length = 0;
+    uint32_t maxLength = 0;
+    ns3::Time lastChange;
+};
+
+inline QueueTelemetry queueStats;
+
+inline void
+QueueSojourn (ns3::Time sojourn)
+{
+    queueStats.sojournUs.Add (sojourn.GetMicroSeconds ());
+}
+
+inline void
+QueueLength (uint32_t oldval, uint32_t newval)
+{
+    ns3::Time now = ns3::Simulator::Now ();
+    if (oldval >= queueStats.timeAtLength.size ())
+    {
+        queueStats.timeAtLength.resize (oldval + 1, 0.0);
+    }
+    queueStats.timeAtLength[oldval] += (now - queueStats.lastChange).GetSeconds ();
+    queueStats.lastChange = now;
+    queueStats.length = newval;
+    queueStats.maxLength = std::max (queueStats.maxLength, newval);
+}
+
+// Time-weighted percentile of the queue length, in packets.
+inline uint32_t
+QueueLengthPercentile (double p)
+{
+    double total = 0.0;
+    for (double t : queueStats.timeAtLength)
+    {
+        total += t;
+    }
+    double seen = 0.0;
+    for (uint32_t len = 0; len < queueStats.timeAtLength.size (); ++len)
+    {
+        seen += queueStats.timeAtLength[len];
+        if (seen >= p / 100.0 * total)
+        {
+            return len;
+        }
+    }
+    return queueStats.maxLength;
+}
+
+inline double
+QueueLengthMean ()
+{
+    double total = 0.0;
+    double weighted = 0.0;
+    for (uint32_t len = 0; len < queueStats.timeAtLength.size (); ++len)
+    {
+        total += queueStats.timeAtLength[len];
+        weighted += len * queueStats.timeAtLength[len];
+    }
+    return total > 0 ? weighted / total : 0.0;
+}
+
+inline std::string
+QueueDiscTypeId (std::string name)
+{
+    if (name == "pfifo")
+    {
+        return "ns3::PfifoFastQueueDisc";
+    }
+    if (name == "red")
+    {
+        return "ns3::RedQueueDisc";
+    }
+    if (name == "codel")
+    {
+        return "ns3::CoDelQueueDisc";
+    }
+    if (name == "fqcodel")
+    {
+        return "ns3::FqCoDelQueueDisc";
+    }
+    if (name == "pie")
+    {
+        return "ns3::PieQueueDisc";
+    }
+    NS_ABORT_MSG ("Unknown queueDisc " << name << " (pfifo, red, codel, fqcodel, pie, none or default)");
+    return "";
+}
+
+// Replaces the root queue disc of the bottleneck's sending device
+// (bottleneck.Get (0)) unless queueDisc is "default", and returns the disc
+// the telemetry traces are connected to: the installed one, the default one
+// when queueTelemetry asks for it, or null. Ipv4AddressHelper::Assign installs
+// the default root queue disc (FqCoDel), so call this after the bottleneck's
+// addresses are assigned.
+inline ns3::Ptr<ns3::QueueDisc>
+SetupBottleneckQueue (std::string queueDisc, std::string queueSize, bool queueTelemetry,
+                      ns3::NetDeviceContainer bottleneck)
+{
+    ns3::Ptr<ns3::QueueDisc> qdisc;
+    if (queueDisc != "default")
+    {
+        ns3::TrafficControlHelper tch;
+        tch.Uninstall (bottleneck);
+        if (queueDisc != "none")
+        {
+            tch.SetRootQueueDisc (QueueDiscTypeId (queueDisc), "MaxSize", ns3::StringValue (queueSize));
+            qdisc = tch.Install (bottleneck).Get (0);
+        }
+    }
+    else if (queueTelemetry)
+    {
+        ns3::Ptr<ns3::NetDevice> device = bottleneck.Get (0);
+        qdisc = device->GetNode ()->GetObject<ns3::TrafficControlLayer> ()->GetRootQueueDiscOnDevice (device);
+        NS_ABORT_MSG_UNLESS (qdisc, "No root queue disc on the bottleneck");
+    }
+    if (qdisc)
+    {
+        qdisc->TraceConnectWithoutContext ("SojournTime", ns3::MakeCallback (&QueueSojourn));
+        qdisc->TraceConnectWithoutContext ("PacketsInQueue", ns3::MakeCallback (&QueueLength));
+    }
+    return qdisc;
+}
+
+inline void
+PrintQueueTelemetry (std::string queueDisc, ns3::Ptr<ns3::QueueDisc> qdisc, std::string tag)
+{
+    QueueLength (queueStats.length, queueStats.length);
+    const LogHistogram &h = queueStats.sojournUs;
+    std::cout << "Bottleneck queue (" << queueDisc << "): " << h.total << " packets, sojourn p50 "
+              << h.Percentile (50) / 1000 << " ms, p90 " << h.Percentile (90) / 1000
+              << " ms, p99 " << h.Percentile (99) / 1000 << " ms, p99.9 " << h.Percentile (99.9) / 1000
+              << " ms, max " << h.max / 1000 << " ms" << std::endl;
+    std::cout << "Bottleneck queue length: mean " << QueueLengthMean () << ", p50 " << QueueLengthPercentile (50)
+              << ", p99 " << QueueLengthPercentile (99) << ", max " << queueStats.maxLength
+              << " packets, " << qdisc->GetStats ().nTotalDroppedPackets << " dropped" << std::endl;
+    std::cout << "PARSE_QUEUE," << tag << "," << h.Percentile (50) / 1000 << "," << h.Percentile (90) / 1000 << ","
+              << h.Percentile (99) / 1000 << "," << h.Percentile (99.9) / 1000 << "," << h.max / 1000 << ","
+              << QueueLengthMean () << "," << QueueLengthPercentile (99) << "," << queueStats.maxLength << ","
+              << qdisc->GetStats ().nTotalDroppedPackets << std::endl;
+}
+
+#endif // LAB_QUEUE_TELEMETRY_H
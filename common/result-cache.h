@@ -0,0 +1,272 @@
+// Result cache (--cacheDir) shared by the Lab1 and lab2 programs.
+//
+// A run is keyed by the program's revision, the build of the program and of
+// the ns-3 libraries it runs on (ResultCacheBuildId), every command-line
+// argument (sorted, the last one winning as in CommandLine), the
+// NS_GLOBAL_VALUE/NS_ATTRIBUTE_DEFAULT environment, the effective RNG seed
+// and run, plus whatever the program adds (e.g. the TCP variant). A hit
+// replays the stored stdout and stderr; a miss tees both and stores them at
+// the end. Wall-clock and memory measurements are written to UncachedOut ()
+// instead, so a hit never replays them as if they had just been measured.
+//
+// ns-3 builds every scratch/*.cc as its own program, so copy the headers in
+// common/ into scratch/ next to the programs that include them.
+
+#ifndef LAB_RESULT_CACHE_H
+#define LAB_RESULT_CACHE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <streambuf>
+#include <string>
+
+#include <link.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "ns3/core-module.h"
+#if defined(ENABLE_BUILD_VERSION) && __has_include("ns3/version.h")
+#include "ns3/version.h"
+#define LAB_RESULT_CACHE_NS3_VERSION 1
+#endif
+
+class TeeStreamBuf : public std::streambuf
+{
+  public:
+    TeeStreamBuf (std::streambuf *sink, std::string *copy)
+        : m_sink (sink),
+          m_copy (copy)
+    {
+    }
+
+  protected:
+    int overflow (int c) override
+    {
+        if (traits_type::eq_int_type (c, traits_type::eof ()))
+        {
+            return traits_type::not_eof (c);
+        }
+        m_copy->push_back (traits_type::to_char_type (c));
+        return m_sink->sputc (traits_type::to_char_type (c));
+    }
+
+    std::streamsize xsputn (const char *s, std::streamsize n) override
+    {
+        m_copy->append (s, n);
+        return m_sink->sputn (s, n);
+    }
+
+    int sync () override
+    {
+        return m_sink->pubsync ();
+    }
+
+  private:
+    std::streambuf *m_sink;
+    std::string *m_copy;
+};
+
+struct ResultCache
+{
+    std::string path; // empty unless this run is being captured
+    std::string key;
+    std::string out;
+    std::string log;
+    std::unique_ptr<TeeStreamBuf> outTee;
+    std::unique_ptr<TeeStreamBuf> logTee;
+    std::streambuf *outSink = nullptr;
+    std::streambuf *logSink = nullptr;
+
+    ~ResultCache ()
+    {
+        // cout and clog outlive us; never leave them writing into a dead tee
+        if (outSink != nullptr)
+        {
+            std::cout.rdbuf (outSink);
+            std::clog.rdbuf (logSink);
+        }
+    }
+};
+
+inline ResultCache resultCache;
+
+inline uint64_t
+Fnv1a64 (const std::string &data)
+{
+    uint64_t hash = 14695981039346656037ULL;
+    for (unsigned char c : data)
+    {
+        hash = (hash ^ c) * 1099511628211ULL;
+    }
+    return hash;
+}
+
+// Identifies a build product without reading it: a rebuild or relink
+// replaces the file, which changes its inode, size or modification time.
+inline std::string
+ResultCacheFileId (const char *path)
+{
+    struct stat st;
+    if (stat (path, &st) != 0)
+    {
+        return "missing";
+    }
+    return std::to_string (st.st_dev) + ":" + std::to_string (st.st_ino) + " " + std::to_string (st.st_size) +
+           " " + std::to_string (st.st_mtim.tv_sec) + "." + std::to_string (st.st_mtim.tv_nsec);
+}
+
+// The simulator actually running: the ns-3 version when it was configured
+// with --enable-build-version, this executable (which holds all of ns-3 in a
+// static build) and every loaded libns3 library, each by ResultCacheFileId.
+// Rebuilding or relinking either side changes it.
+inline std::string
+ResultCacheBuildId ()
+{
+    std::ostringstream id;
+#ifdef LAB_RESULT_CACHE_NS3_VERSION
+    id << "ns-3 " << ns3::Version::LongVersion () << "\n";
+#endif
+    id << "exe " << ResultCacheFileId ("/proc/self/exe") << "\n";
+
+    std::map<std::string, std::string> libraries;
+    dl_iterate_phdr (
+        [] (struct dl_phdr_info *info, std::size_t, void *data) {
+            std::string path = info->dlpi_name != nullptr ? info->dlpi_name : "";
+            if (path.find ("libns3") != std::string::npos)
+            {
+                (*static_cast<std::map<std::string, std::string> *> (data))[path] = ResultCacheFileId (path.c_str ());
+            }
+            return 0;
+        },
+        &libraries);
+    for (const auto &library : libraries)
+    {
+        id << "lib " << library.first << " " << library.second << "\n";
+    }
+    return id.str ();
+}
+
+// 'version' names the program revision; 'extra' is appended to the key as
+// one more line when not empty.
+inline std::string
+ResultCacheKey (const char *version, int argc, char *argv[], std::string extra = "")
+{
+    std::map<std::string, std::string> args;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        arg.erase (0, arg.find_first_not_of ('-'));
+        std::size_t eq = arg.find ('=');
+        std::string name = arg.substr (0, eq);
+        if (name != "cacheDir")
+        {
+            args[name] = eq == std::string::npos ? "true" : arg.substr (eq + 1);
+        }
+    }
+    std::ostringstream key;
+    key << version << "\n" << ResultCacheBuildId ();
+    for (const auto &arg : args)
+    {
+        key << arg.first << "=" << arg.second << "\n";
+    }
+    for (const char *var : {"NS_GLOBAL_VALUE", "NS_ATTRIBUTE_DEFAULT"})
+    {
+        const char *value = std::getenv (var);
+        key << var << "=" << (value != nullptr ? value : "") << "\n";
+    }
+    key << "RngSeed=" << ns3::SeedManager::GetSeed () << " RngRun=" << ns3::SeedManager::GetRun () << "\n";
+    if (!extra.empty ())
+    {
+        key << extra << "\n";
+    }
+    return key.str ();
+}
+
+// On a hit prints the stored output and returns true. On a miss starts
+// capturing cout and clog for StoreCachedResult and returns false.
+inline bool
+LookupCachedResult (std::string cacheDir, std::string key)
+{
+    mkdir (cacheDir.c_str (), 0777);
+    char name[17];
+    std::snprintf (name, sizeof (name), "%016llx", static_cast<unsigned long long> (Fnv1a64 (key)));
+    std::string path = cacheDir + "/" + name + ".result";
+
+    // "RESULT1 <key bytes> <stdout bytes> <stderr bytes>\n" then the three
+    // blobs; the stored key guards against hash collisions.
+    std::ifstream in (path, std::ios::binary);
+    std::string magic;
+    std::size_t keySize = 0;
+    std::size_t outSize = 0;
+    std::size_t logSize = 0;
+    if (in >> magic >> keySize >> outSize >> logSize && magic == "RESULT1" && in.get () == '\n')
+    {
+        std::string stored (keySize + outSize + logSize, '\0');
+        if (in.read (&stored[0], stored.size ()) && stored.compare (0, keySize, key) == 0)
+        {
+            std::cout << stored.substr (keySize, outSize) << std::flush;
+            std::clog << stored.substr (keySize + outSize) << std::flush;
+            std::cerr << "(cached result " << path << ")" << std::endl;
+            return true;
+        }
+    }
+
+    resultCache.path = path;
+    resultCache.key = key;
+    resultCache.outSink = std::cout.rdbuf ();
+    resultCache.logSink = std::clog.rdbuf ();
+    resultCache.outTee.reset (new TeeStreamBuf (resultCache.outSink, &resultCache.out));
+    resultCache.logTee.reset (new TeeStreamBuf (resultCache.logSink, &resultCache.log));
+    std::cout.rdbuf (resultCache.outTee.get ());
+    std::clog.rdbuf (resultCache.logTee.get ());
+    return false;
+}
+
+// Stdout for measurements of this process (wall-clock, events/s, RSS). They
+// reach stdout like everything else but bypass the capture, so cached
+// results never contain them.
+inline std::ostream &
+UncachedOut ()
+{
+    static std::ostream out (nullptr);
+    out.rdbuf (resultCache.outSink != nullptr ? resultCache.outSink : std::cout.rdbuf ());
+    return out;
+}
+
+// Every writer fills its own temporary file and renames it over the entry,
+// so parallel sweep workers sharing a cacheDir never expose a partial result:
+// readers see no entry, or one complete entry.
+inline void
+StoreCachedResult ()
+{
+    if (resultCache.path.empty ())
+    {
+        return;
+    }
+    std::cout.flush ();
+    std::clog.flush ();
+    std::cout.rdbuf (resultCache.outSink);
+    std::clog.rdbuf (resultCache.logSink);
+    resultCache.outSink = nullptr;
+
+    std::string tmp = resultCache.path + ".tmp." + std::to_string (getpid ());
+    std::ofstream file (tmp, std::ios::binary);
+    file << "RESULT1 " << resultCache.key.size () << " " << resultCache.out.size () << " "
+         << resultCache.log.size () << "\n"
+         << resultCache.key << resultCache.out << resultCache.log;
+    file.close ();
+    if (!file || std::rename (tmp.c_str (), resultCache.path.c_str ()) != 0)
+    {
+        std::remove (tmp.c_str ());
+        std::cerr << "Could not store " << resultCache.path << std::endl;
+    }
+    resultCache.path.clear ();
+}
+
+#endif // LAB_RESULT_CACHE_H
@@ -0,0 +1,43 @@
+// --scheduler selection and the PARSE_SCHED report shared by the Lab1 and
+// lab2 programs. Copy it into scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_SCHEDULER_H
+#define LAB_SCHEDULER_H
+
+#include <cstdint>
+#include <iostream>
+#include <map>
+#include <string>
+
+#include "ns3/core-module.h"
+#include "result-cache.h"
+
+inline void
+SetScheduler (std::string scheduler)
+{
+    static const std::map<std::string, std::string> types = {
+        {"map", "ns3::MapScheduler"},
+        {"heap", "ns3::HeapScheduler"},
+        {"list", "ns3::ListScheduler"},
+        {"calendar", "ns3::CalendarScheduler"},
+        {"priorityqueue", "ns3::PriorityQueueScheduler"}};
+    auto it = types.find (scheduler);
+    NS_ABORT_MSG_IF (it == types.end (), "Unknown scheduler " << scheduler);
+    ns3::ObjectFactory factory;
+    factory.SetTypeId (it->second);
+    ns3::Simulator::SetScheduler (factory);
+}
+
+// 'tag' is the "<prog/prot>,<size>,<run>" prefix of the PARSE_SCHED line.
+// Both lines are timings, so they are left out of --cacheDir results.
+inline void
+PrintSchedulerStats (std::string scheduler, std::string tag, double wallSeconds)
+{
+    uint64_t events = ns3::Simulator::GetEventCount ();
+    UncachedOut () << "Scheduler " << scheduler << ": " << events << " events in " << wallSeconds << " s wall-clock, "
+              << events / wallSeconds << " events/s" << std::endl;
+    UncachedOut () << "PARSE_SCHED," << tag << "," << scheduler << "," << events << "," << wallSeconds << ","
+              << events / wallSeconds << std::endl;
+}
+
+#endif // LAB_SCHEDULER_H
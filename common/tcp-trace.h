@@ -0,0 +1,510 @@
+// CWND tracing (--tracing) and per-socket probes (--probe) shared by the
+// lab2 programs. Copy it into scratch/ next to them (see result-cache.h).
+
+#ifndef LAB_TCP_TRACE_H
+#define LAB_TCP_TRACE_H
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/applications-module.h"
+
+#include "callback-profile.h"
+
+const std::size_t kTraceChunkBytes = 1 << 20;
+// Per-flow text traces share one kTraceChunkBytes budget, so a buffer is
+// flushed at kTraceChunkBytes / nFlows (but never below kTraceMinFlushBytes).
+// Above kMaxTraceFiles flows only the single binary trace file is allowed.
+const std::size_t kTraceMinFlushBytes = 4096;
+const uint32_t kMaxTraceFiles = 256;
+inline std::size_t traceFlushBytes = kTraceChunkBytes;
+
+struct CwndFlowTrace
+{
+    std::FILE *file = nullptr;
+    std::string buffer;
+    bool first = true;
+    // Current --traceBucket aggregate.
+    int64_t bucket = 0;
+    uint32_t min = 0;
+    uint32_t max = 0;
+    double sum = 0;
+    uint32_t last = 0;
+    uint32_t count = 0;
+};
+
+inline std::vector<CwndFlowTrace> cwndFlows;
+inline uint64_t cwndEvents = 0;
+
+inline std::map<uint64_t, ns3::Ptr<ns3::OutputStreamWrapper>> cWndStream;
+inline std::map<uint64_t, bool> firstCwnd;
+
+inline std::pair<uint32_t, uint32_t>
+GetIdsFromContext (std::string context)
+{
+    std::size_t const n1 = context.find_first_of ("/", 1);
+    std::size_t const n2 = context.find_first_of ("/", n1 + 1);
+    uint32_t nodeId = std::stoul (context.substr (n1 + 1, n2 - n1 - 1));
+
+    std::size_t const s1 = context.find ("SocketList/");
+    if (s1 == std::string::npos)
+    {
+        return {nodeId, 0};
+    }
+    std::size_t const s2 = context.find ("/", s1 + 11);
+    uint32_t socketId = std::stoul (context.substr (s1 + 11, s2 - (s1 + 11)));
+
+    return {nodeId, socketId};
+}
+
+// Original per-event tracer, kept as the "text" baseline for the events/sec comparison.
+inline void
+TextCwndTracer (std::string context, uint32_t oldval, uint32_t newval)
+{
+    ProfileScope scope (kProfileCwndTracer);
+    ++cwndEvents;
+    std::pair<uint32_t, uint32_t> ids = GetIdsFromContext (context);
+    uint64_t mapId = (static_cast<uint64_t> (ids.first) << 32) | ids.second;
+
+    if (firstCwnd.find (mapId) == firstCwnd.end ())
+    {
+        firstCwnd[mapId] = true;
+    }
+
+    if (firstCwnd[mapId])
+    {
+        *cWndStream[mapId]->GetStream () << "0.0 " << oldval << std::endl;
+        firstCwnd[mapId] = false;
+    }
+    *cWndStream[mapId]->GetStream () << ns3::Simulator::Now ().GetSeconds () << " " << newval << std::endl;
+}
+
+inline void
+TraceCwndText (std::string cwnd_tr_file_name, uint32_t nodeId, uint32_t socketId)
+{
+    uint64_t mapId = (static_cast<uint64_t> (nodeId) << 32) | socketId;
+    ns3::AsciiTraceHelper ascii;
+    cWndStream[mapId] = ascii.CreateFileStream (cwnd_tr_file_name);
+
+    ns3::Config::Connect ("/NodeList/" + std::to_string (nodeId) +
+                          "/$ns3::TcpL4Protocol/SocketList/" + std::to_string (socketId) +
+                          "/CongestionWindow",
+                          ns3::MakeCallback (&TextCwndTracer));
+}
+
+inline void
+FlushCwndFlow (CwndFlowTrace &flow)
+{
+    if (!flow.buffer.empty ())
+    {
+        std::fwrite (flow.buffer.data (), 1, flow.buffer.size (), flow.file);
+        flow.buffer.clear ();
+    }
+}
+
+// Decimated CWND trace (--traceBucket): one "time min max mean last count"
+// row per flow and non-empty bucket of simulated time, so the file grows with
+// the duration rather than the event count and keeps the sawtooth extremes.
+inline ns3::Time cwndBucket;
+
+inline void
+WriteCwndBucket (CwndFlowTrace &flow)
+{
+    char line[128];
+    flow.buffer.append (line, std::snprintf (line, sizeof (line), "%g %u %u %g %u %u\n",
+                                             flow.bucket * cwndBucket.GetSeconds (), flow.min, flow.max,
+                                             flow.sum / flow.count, flow.last, flow.count));
+    flow.count = 0;
+    if (flow.buffer.size () >= traceFlushBytes)
+    {
+        FlushCwndFlow (flow);
+    }
+}
+
+inline void
+AddCwndSample (CwndFlowTrace &flow, int64_t bucket, uint32_t value)
+{
+    if (flow.count > 0 && bucket != flow.bucket)
+    {
+        WriteCwndBucket (flow);
+    }
+    if (flow.count == 0)
+    {
+        flow.bucket = bucket;
+        flow.min = value;
+        flow.max = value;
+        flow.sum = 0;
+    }
+    flow.min = std::min (flow.min, value);
+    flow.max = std::max (flow.max, value);
+    flow.sum += value;
+    flow.last = value;
+    ++flow.count;
+}
+
+// Binary CWND trace: a single file for all flows, in host byte order. A
+// 16-byte header ("CWND", version, nFlows, 0) is followed by chunks of up to
+// kBinaryChunkRecords records stored column-wise: uint32 count, uint32 pad,
+// int64 time_ns[count], uint32 flow[count], uint32 cwnd[count].
+// tools/cwnd-trace-reader.cc maps it and exports the per-flow text files.
+const uint32_t kBinaryChunkRecords = 65536;
+const uint32_t kBinaryTraceVersion = 1;
+
+struct CwndBinaryTrace
+{
+    std::FILE *file = nullptr;
+    std::vector<int64_t> timeNs;
+    std::vector<uint32_t> flow;
+    std::vector<uint32_t> value;
+};
+
+inline CwndBinaryTrace cwndBinary;
+
+inline void
+FlushCwndBinary ()
+{
+    uint32_t count[2] = {static_cast<uint32_t> (cwndBinary.timeNs.size ()), 0};
+    if (count[0] == 0)
+    {
+        return;
+    }
+    std::fwrite (count, sizeof (count), 1, cwndBinary.file);
+    std::fwrite (cwndBinary.timeNs.data (), sizeof (int64_t), count[0], cwndBinary.file);
+    std::fwrite (cwndBinary.flow.data (), sizeof (uint32_t), count[0], cwndBinary.file);
+    std::fwrite (cwndBinary.value.data (), sizeof (uint32_t), count[0], cwndBinary.file);
+    cwndBinary.timeNs.clear ();
+    cwndBinary.flow.clear ();
+    cwndBinary.value.clear ();
+}
+
+inline void
+OpenCwndBinary (std::string fileName, uint32_t nFlows)
+{
+    cwndBinary.file = std::fopen (fileName.c_str (), "wb");
+    NS_ABORT_MSG_UNLESS (cwndBinary.file != nullptr, "Cannot open " << fileName);
+    const char magic[4] = {'C', 'W', 'N', 'D'};
+    uint32_t header[3] = {kBinaryTraceVersion, nFlows, 0};
+    std::fwrite (magic, 1, sizeof (magic), cwndBinary.file);
+    std::fwrite (header, sizeof (header), 1, cwndBinary.file);
+    cwndBinary.timeNs.reserve (kBinaryChunkRecords);
+    cwndBinary.flow.reserve (kBinaryChunkRecords);
+    cwndBinary.value.reserve (kBinaryChunkRecords);
+}
+
+inline void
+AppendCwndBinary (uint32_t flowId, int64_t timeNs, uint32_t value)
+{
+    cwndBinary.timeNs.push_back (timeNs);
+    cwndBinary.flow.push_back (flowId);
+    cwndBinary.value.push_back (value);
+    if (cwndBinary.timeNs.size () >= kBinaryChunkRecords)
+    {
+        FlushCwndBinary ();
+    }
+}
+
+inline void
+CloseCwndTraces ()
+{
+    for (CwndFlowTrace &flow : cwndFlows)
+    {
+        if (flow.file != nullptr)
+        {
+            if (flow.count > 0)
+            {
+                WriteCwndBucket (flow);
+            }
+            FlushCwndFlow (flow);
+            std::fclose (flow.file);
+            flow.file = nullptr;
+        }
+    }
+    if (cwndBinary.file != nullptr)
+    {
+        FlushCwndBinary ();
+        std::fclose (cwndBinary.file);
+        cwndBinary.file = nullptr;
+    }
+}
+
+inline void
+CwndTracer (uint32_t flowId, uint32_t oldval, uint32_t newval)
+{
+    ProfileScope scope (kProfileCwndTracer);
+    ++cwndEvents;
+    CwndFlowTrace &flow = cwndFlows[flowId];
+    if (cwndBinary.file != nullptr)
+    {
+        if (flow.first)
+        {
+            AppendCwndBinary (flowId, 0, oldval);
+            flow.first = false;
+        }
+        AppendCwndBinary (flowId, ns3::Simulator::Now ().GetNanoSeconds (), newval);
+        return;
+    }
+    if (!cwndBucket.IsZero ())
+    {
+        if (flow.first)
+        {
+            AddCwndSample (flow, 0, oldval);
+            flow.first = false;
+        }
+        AddCwndSample (flow, ns3::Simulator::Now ().GetTimeStep () / cwndBucket.GetTimeStep (), newval);
+        return;
+    }
+    char line[64];
+
+    if (flow.first)
+    {
+        flow.buffer.append (line, std::snprintf (line, sizeof (line), "0.0 %u\n", oldval));
+        flow.first = false;
+    }
+    flow.buffer.append (line, std::snprintf (line, sizeof (line), "%g %u\n",
+                                             ns3::Simulator::Now ().GetSeconds (), newval));
+    if (flow.buffer.size () >= traceFlushBytes)
+    {
+        FlushCwndFlow (flow);
+    }
+}
+
+inline void
+TraceCwnd (std::string cwnd_tr_file_name, uint32_t flowId, ns3::Ptr<ns3::Application> app)
+{
+    // An empty file name means the flow goes to the shared binary trace.
+    if (!cwnd_tr_file_name.empty ())
+    {
+        CwndFlowTrace &flow = cwndFlows[flowId];
+        flow.file = std::fopen (cwnd_tr_file_name.c_str (), "w");
+        NS_ABORT_MSG_UNLESS (flow.file != nullptr, "Cannot open " << cwnd_tr_file_name);
+        std::setvbuf (flow.file, nullptr, _IONBF, 0);
+        flow.buffer.reserve (traceFlushBytes + 64);
+    }
+
+    ns3::Ptr<ns3::Socket> socket = ns3::DynamicCast<ns3::BulkSendApplication> (app)->GetSocket ();
+    socket->TraceConnectWithoutContext ("CongestionWindow", ns3::MakeBoundCallback (&CwndTracer, flowId));
+}
+
+// Hooks the CWND of the nFlows BulkSend sources (flow i is sourceApps.Get (i)
+// on node 'sourceNodeId') once they have created their sockets.
+inline void
+EnableCwndTracing (std::string prefix, std::string traceMode, std::string traceFormat, uint32_t nFlows,
+                   uint32_t sourceNodeId, ns3::ApplicationContainer sourceApps, double sourceStartTime)
+{
+    cwndFlows.resize (nFlows);
+    ns3::Simulator::ScheduleDestroy (&CloseCwndTraces);
+    if (traceFormat == "binary")
+    {
+        OpenCwndBinary (prefix + "-cwnd.bin", nFlows);
+    }
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        std::string flowString = "-flow" + std::to_string (i);
+        std::string traceFile = prefix + flowString + "-cwnd.data";
+
+        if (traceMode == "text")
+        {
+            ns3::Simulator::Schedule (ns3::Seconds (sourceStartTime + 0.00001),
+                                      &TraceCwndText,
+                                      traceFile,
+                                      sourceNodeId,
+                                      i);
+        }
+        else
+        {
+            ns3::Simulator::Schedule (ns3::Seconds (sourceStartTime + 0.00001),
+                                      &TraceCwnd,
+                                      traceFormat == "binary" ? std::string () : traceFile,
+                                      i,
+                                      sourceApps.Get (i));
+        }
+    }
+}
+
+inline void
+PrintCwndTraceStats (std::string traceMode, std::string traceFormat, double wallSeconds)
+{
+    std::cout << "CWND trace (" << traceMode << ", " << traceFormat << "): " << cwndEvents << " events in "
+              << wallSeconds << " s wall-clock, " << cwndEvents / wallSeconds << " events/s" << std::endl;
+}
+
+// Per-socket probe: one row per simulated instant at which cwnd, ssthresh,
+// RTT, RTO, bytes in flight or the congestion state changed, holding the
+// values after every update at that instant. The first row is the socket's
+// state when the probe connects.
+struct SocketProbe
+{
+    CwndFlowTrace out;
+    ns3::Time lastUpdate;
+    bool pending = false;
+    uint32_t cwnd = 0;
+    uint32_t ssthresh = 0;
+    ns3::Time rtt;
+    ns3::Time rto;
+    uint32_t inFlight = 0;
+    ns3::TcpSocketState::TcpCongState_t congState = ns3::TcpSocketState::CA_OPEN;
+};
+
+inline std::vector<SocketProbe> probes;
+inline uint64_t probeEvents = 0;
+
+inline void
+WriteProbeRow (SocketProbe &probe)
+{
+    char line[128];
+    probe.out.buffer.append (line, std::snprintf (line, sizeof (line), "%g %u %u %g %g %u %s\n",
+                                                  probe.lastUpdate.GetSeconds (), probe.cwnd, probe.ssthresh,
+                                                  probe.rtt.GetSeconds () * 1000, probe.rto.GetSeconds () * 1000,
+                                                  probe.inFlight,
+                                                  ns3::TcpSocketState::TcpCongStateName[probe.congState]));
+    probe.pending = false;
+    if (probe.out.buffer.size () >= traceFlushBytes)
+    {
+        FlushCwndFlow (probe.out);
+    }
+}
+
+// Every hook goes through here first, which closes the previous instant's row.
+inline SocketProbe &
+ProbeUpdate (uint32_t flowId)
+{
+    ProfileScope scope (kProfileProbe);
+    ++probeEvents;
+    SocketProbe &probe = probes[flowId];
+    ns3::Time now = ns3::Simulator::Now ();
+    if (probe.pending && now != probe.lastUpdate)
+    {
+        WriteProbeRow (probe);
+    }
+    probe.lastUpdate = now;
+    probe.pending = true;
+    return probe;
+}
+
+inline void
+ProbeCwnd (uint32_t flowId, uint32_t oldval, uint32_t newval)
+{
+    ProbeUpdate (flowId).cwnd = newval;
+}
+
+inline void
+ProbeSsthresh (uint32_t flowId, uint32_t oldval, uint32_t newval)
+{
+    ProbeUpdate (flowId).ssthresh = newval;
+}
+
+inline void
+ProbeRtt (uint32_t flowId, ns3::Time oldval, ns3::Time newval)
+{
+    ProbeUpdate (flowId).rtt = newval;
+}
+
+inline void
+ProbeRto (uint32_t flowId, ns3::Time oldval, ns3::Time newval)
+{
+    ProbeUpdate (flowId).rto = newval;
+}
+
+inline void
+ProbeInFlight (uint32_t flowId, uint32_t oldval, uint32_t newval)
+{
+    ProbeUpdate (flowId).inFlight = newval;
+}
+
+inline void
+ProbeCongState (uint32_t flowId, ns3::TcpSocketState::TcpCongState_t oldval,
+                ns3::TcpSocketState::TcpCongState_t newval)
+{
+    ProbeUpdate (flowId).congState = newval;
+}
+
+inline void
+CloseProbes ()
+{
+    for (SocketProbe &probe : probes)
+    {
+        if (probe.out.file != nullptr)
+        {
+            if (probe.pending)
+            {
+                WriteProbeRow (probe);
+            }
+            FlushCwndFlow (probe.out);
+            std::fclose (probe.out.file);
+            probe.out.file = nullptr;
+        }
+    }
+}
+
+inline void
+ProbeSocket (std::string probe_file_name, uint32_t flowId, ns3::Ptr<ns3::Application> app)
+{
+    SocketProbe &probe = probes[flowId];
+    probe.out.file = std::fopen (probe_file_name.c_str (), "w");
+    NS_ABORT_MSG_UNLESS (probe.out.file != nullptr, "Cannot open " << probe_file_name);
+    std::setvbuf (probe.out.file, nullptr, _IONBF, 0);
+    probe.out.buffer.reserve (traceFlushBytes + 128);
+    probe.out.buffer = "# time cwnd ssthresh rtt_ms rto_ms bytes_in_flight cong_state\n";
+
+    // The hooks only report changes, so seed the row from the socket, which
+    // has just sent its SYN: the initial window and threshold, no RTT sample
+    // yet, and the connection timer standing in for the RTO until the first
+    // estimate.
+    ns3::Ptr<ns3::Socket> socket = ns3::DynamicCast<ns3::BulkSendApplication> (app)->GetSocket ();
+    ns3::UintegerValue segmentSize;
+    ns3::UintegerValue initialCwnd;
+    ns3::UintegerValue initialSsthresh;
+    ns3::TimeValue connTimeout;
+    socket->GetAttribute ("SegmentSize", segmentSize);
+    socket->GetAttribute ("InitialCwnd", initialCwnd);
+    socket->GetAttribute ("InitialSlowStartThreshold", initialSsthresh);
+    socket->GetAttribute ("ConnTimeout", connTimeout);
+    probe.cwnd = initialCwnd.Get () * segmentSize.Get ();
+    probe.ssthresh = initialSsthresh.Get ();
+    probe.rto = connTimeout.Get ();
+    probe.lastUpdate = ns3::Simulator::Now ();
+    probe.pending = true;
+
+    socket->TraceConnectWithoutContext ("CongestionWindow", ns3::MakeBoundCallback (&ProbeCwnd, flowId));
+    socket->TraceConnectWithoutContext ("SlowStartThreshold", ns3::MakeBoundCallback (&ProbeSsthresh, flowId));
+    socket->TraceConnectWithoutContext ("RTT", ns3::MakeBoundCallback (&ProbeRtt, flowId));
+    socket->TraceConnectWithoutContext ("RTO", ns3::MakeBoundCallback (&ProbeRto, flowId));
+    socket->TraceConnectWithoutContext ("BytesInFlight", ns3::MakeBoundCallback (&ProbeInFlight, flowId));
+    socket->TraceConnectWithoutContext ("CongState", ns3::MakeBoundCallback (&ProbeCongState, flowId));
+}
+
+// Probes the nFlows BulkSend sources (flow i is sourceApps.Get (i)) into
+// <prefix>-flow<i>-probe.data once they have created their sockets.
+inline void
+EnableSocketProbes (std::string prefix, uint32_t nFlows, ns3::ApplicationContainer sourceApps,
+                    double sourceStartTime)
+{
+    probes.resize (nFlows);
+    ns3::Simulator::ScheduleDestroy (&CloseProbes);
+    for (uint32_t i = 0; i < nFlows; ++i)
+    {
+        ns3::Simulator::Schedule (ns3::Seconds (sourceStartTime + 0.00001),
+                                  &ProbeSocket,
+                                  prefix + "-flow" + std::to_string (i) + "-probe.data",
+                                  i,
+                                  sourceApps.Get (i));
+    }
+}
+
+inline void
+PrintProbeStats (double wallSeconds)
+{
+    std::cout << "Socket probe: " << probeEvents << " updates in " << wallSeconds << " s wall-clock, "
+              << probeEvents / wallSeconds << " updates/s" << std::endl;
+}
+
+#endif // LAB_TCP_TRACE_H